@@ -15,11 +15,20 @@ AGaus::~AGaus() {
 double AGaus::operator()( const double& x ){
   const double a = 0.5 * sqrt( 2.0 * M_PI );
   double area = a * ( sigmap_  + sigmam_ );
-  return
-    a_ *
-    exp( - 0.5 * pow( ( x - mean_ ) / ( x > mean_ ? sigmap_ : sigmam_ ),
-		      2.0 ) )
-    / area;
+  double d = ( x - mean_ ) / ( x > mean_ ? sigmap_ : sigmam_ );
+  return a_ * exp( - 0.5 * d * d ) / area;
+}
+
+// constants are calculated once, and the loop has no branch nor division
+void AGaus::eval( const double* x, double* out, const size_t& n ){
+  const double a = 0.5 * sqrt( 2.0 * M_PI );
+  double norm = a_ / ( a * ( sigmap_  + sigmam_ ) );
+  double cp = - 0.5 / ( sigmap_ * sigmap_ );
+  double cm = - 0.5 / ( sigmam_ * sigmam_ );
+  for( size_t i = 0; i < n; i++ ){
+    double d = x[ i ] - mean_;
+    out[ i ] = norm * exp( ( d > 0.0 ? cp : cm ) * d * d );
+  }
 }
 
 string AGaus::text() const {
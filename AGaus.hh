@@ -15,6 +15,7 @@ public:
   AGaus();
   virtual ~AGaus();
   virtual double operator()( const double& x );
+  virtual void eval( const double* x, double* out, const std::size_t& n );
 
   virtual double upper() const ;
   virtual double lower() const ;
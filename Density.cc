@@ -6,6 +6,10 @@ Density::Density() : TObject() {
 Density::~Density(){
 }
 
+void Density::eval( const double* x, double* out, const std::size_t& n ){
+  for( std::size_t i = 0; i < n; i++ ) out[ i ] = (*this)( x[ i ] );
+}
+
 
 
 
@@ -4,6 +4,7 @@
 #include <Tranform/RealFunction.hh>
 #include <TObject.h>
 #include <string>
+#include <cstddef>
 
 class Density : public Transform::RealFunction,
 		public TObject {
@@ -12,6 +13,10 @@ public:
   Density();
   virtual ~Density();
 
+  // out[i] = (*this)( x[i] ) for i < n: override with a loop
+  // the compiler can vectorize (no virtual call per point)
+  virtual void eval( const double* x, double* out, const std::size_t& n );
+
   virtual double upper() const = 0;
   virtual double lower() const = 0;
   
@@ -6,7 +6,7 @@
 
 using namespace std;
 
-DipoleKernel::DipoleKernel() : core_(), lines_( 0 ) {
+DipoleKernel::DipoleKernel() : core_(), lines_( 0 ), a_( 0 ) {
 }
 
 DipoleKernel::~DipoleKernel() {
@@ -23,7 +23,8 @@ double DipoleKernel::localField( const double& r ){
 
 double DipoleKernel::weight( const double& r ){
   const double c = M_PI / 4.185;
-  return c * pow( r, 5.0 );
+  double r2 = r * r;
+  return c * r2 * r2 * r; // pow() is slow: this is called for every quadrature node
 }
 
 // actual definition of the kernel functional form.
@@ -36,15 +37,54 @@ double DipoleKernel::eval( const double& r ){
     0.0 ;
 }
 
+void DipoleKernel::eval( const double* r, double* out, const size_t& n ){
+  if( n == 0 ) return;
+  this->core( r, this->t(), out, n );
+  for( size_t i = 0; i < n; i++ ) out[ i ] = r[ i ] > 0.0 ? this->weight( r[ i ] ) * out[ i ] : 0.0;
+}
+
+// r^3 / 1.395 is common to all lines: calculated once
 double DipoleKernel::core( const double& r, const double& t ){
-  if( lines_.size() == 0 ) return core_( r, t );
+  double a = r * r * r;
+  if( lines_.size() == 0 ) return core_.ftilde( - t * a / 1.395 );
   double fv = 0.0;
   for( int i = 0; i < lines_.size(); i++ ){
-    fv += core_( r, t - lines_[ i ] );
+    fv += core_.ftilde( - ( t - lines_[ i ] ) * a / 1.395 );
   }
   return fv;
 }
 
+// line by line over all r: the inner loop has no call
+void DipoleKernel::core( const double* r, const double& t, double* out, const size_t& n ){
+  if( n == 0 ) return;
+  a_.resize( n );
+  for( size_t i = 0; i < n; i++ ){
+    a_[ i ] = r[ i ] * r[ i ] * r[ i ];
+    out[ i ] = 0.0;
+  }
+  if( lines_.size() == 0 ) {
+    core_.addFtilde( - t / 1.395, a_.data(), out, n );
+    return;
+  }
+  for( int j = 0; j < lines_.size(); j++ ){
+    core_.addFtilde( - ( t - lines_[ j ] ) / 1.395, a_.data(), out, n );
+  }
+}
+
+/*!
+  f(x) + f(-x) is zero for |x| > 2, x = (t - H_i) r^3 / 1.395:
+  the kernel is not zero only for r <= ( 2 * 1.395 / |t - H_i| )^{1/3}
+  of the nearest line.
+*/
+double DipoleKernel::rmax( const double& t ){
+  double u = fabs( t );
+  if( lines_.size() > 0 ) {
+    u = fabs( t - lines_[ 0 ] );
+    for( int i = 1; i < lines_.size(); i++ ) u = min( u, fabs( t - lines_[ i ] ) );
+  }
+  return u > 0.0 ? cbrt( 2.0 * 1.395 / u ) : HUGE_VAL;
+}
+
 string DipoleKernel::text(){
   ostringstream ost;
   ost << "#tilde{K}(r,t)=#sum_{i}#left(#frac{1#pm((t-H_{i})/A(r))}{3}#right)^{-#frac{1}{2}}";
@@ -66,6 +106,10 @@ void DipoleKernel::offset( const double& v ){
     lines_.push_back( v );
 }
 
+void DipoleKernel::offset( const std::vector< double >& v ){
+  for( int i = 0; i < v.size(); i++ ) this->offset( v[ i ] );
+}
+
 double DipoleKernel::offset(){
   if( lines_.size() == 0 ) return 0.0;
   if( lines_.size() == 1 ) return lines_[ 0 ];
@@ -45,6 +45,9 @@ public:
   // r in nm
   // t() in mT
   virtual double eval( const double& r );
+  
+  // out[i] = eval( r[i] ) for i < n
+  virtual void eval( const double* r, double* out, const std::size_t& n );
 
   // \pi r^2 / 3 / A(r)
   double weight( const double& r );
@@ -52,13 +55,20 @@ public:
   std::string text();
   
   void offset( const double& v );
+  void offset( const std::vector< double >& v ); // e.g. ESRFeatureDetector::GetCenters()
   double offset(); // return mean of offset
+  const std::vector< double >& lines() const { return lines_; }
   
   double core( const double& r, const double& t );
+  void core( const double* r, const double& t, double* out, const std::size_t& n );
+  
+  // largest r where the kernel is not zero at t (HUGE_VAL at a line)
+  double rmax( const double& t );
   
 private:
   KernelCore core_;
   std::vector< double > lines_;        // ESR lines
+  std::vector< double > a_;            //! r^3, work array of core( r, t, out, n )
   
   ClassDef( DipoleKernel, 1.0 );
 };
@@ -1,14 +1,27 @@
 #include "ESR.hh"
 #include "ESRHeader.hh"
 #include "ESRHeaderElement.hh"
+#include "ESRRawFile.hh"
+#include "ESRBinaryHeader.hh"
+#include "ESRTextParser.hh"
+#include "ESRCache.hh"
+#include "ESRStream.hh"
+#include "ESRIntegralTable.hh"
+#include "ESRIntegrator.hh"
+#include "ESRBaseline.hh"
+#include "ESRFeatureDetector.hh"
+#include "MappedFile.hh"
 // #include "ESRUtil.hxx"
 
 #include <fstream>
 #include <stdexcept>
 #include <iomanip>
 #include <algorithm>
+#include <numeric>
 #include <ctime>   // time_t, tm
-#include <cstring> // memset
+#include <cstring> // memcpy
+#include <future>
+#include <type_traits>
 
 #include "TError.h"
 #include "TGraph.h"
@@ -16,6 +29,10 @@
 #include "TArrow.h"
 #include "TFile.h"
 #include "TTree.h"
+#include "TBranch.h"
+#include "TTreeReader.h"
+#include "TTreeReaderValue.h"
+#include "TTreeReaderArray.h"
 
 ClassImp(ESR)
 
@@ -46,8 +63,60 @@ GraphStyle ESR::gs_sig = {64, 2};
 GraphStyle ESR::gs_sig_integ = {2, 3};
 GraphStyle ESR::gs_sig_imag = {412, 1};
 GraphStyle ESR::gs_sig_imag_integ = {807, 2};
+bool ESR::use_cache = false;
+unsigned ESR::default_products = ESR::kNone;
+ESRDecimator::Mode ESR::default_reduction_mode = ESRDecimator::kBoxcar;
+int ESR::root_format_version = 2;
+int ESR::root_compression = 505; // ZSTD, level 5
+bool ESR::root_float_storage = false;
+bool ESR::float_storage = false;
+ESRResampler::Method ESR::arithmetic_interpolation = ESRResampler::kLinear;
 
 
+namespace
+{
+  /* reduced x is common to all channels: own bit in ESR::ready_,
+     outside of ESR::kAll. */
+  const unsigned x_ready = 0x10000;
+
+  /* prefix table of integral (ESR::GetIntegTable): bit per channel. */
+  const unsigned table_ready = 0x100000;
+  const unsigned table_ready_all = 0xf00000;
+
+  /* baseline stage (ESR::GetBaselineStage) made on current reduced data. */
+  const unsigned baseline_ready = 0x1000000;
+
+  /* acc += w * ys for double or float samples: plain loop, vectorised by the compiler. */
+  void accumulate(std::vector<double>& acc, const ESRChannel& ch, double w)
+  {
+    auto n = std::min(acc.size(), ch.GetSize());
+    auto out = acc.data();
+    ch.Visit([&](auto ys)
+             {
+               for(std::size_t i = 0; i < n; ++i)
+                 out[i] += w * ys[i];
+             });
+  }
+
+  void accumulate(std::vector<double>& acc, const std::vector<double>& ys, double w)
+  {
+    auto n = std::min(acc.size(), ys.size());
+    auto out = acc.data();
+    auto in = ys.data();
+    for(std::size_t i = 0; i < n; ++i)
+      out[i] += w * in[i];
+  }
+
+  /* gain to match spectra: 0 (no amplitude in header) is taken as 1, as in ESR(std::map, int). */
+  double matching_gain(const ESR& esr, const char* location)
+  {
+    if(esr.GetGain() != 0)
+      return esr.GetGain();
+    ::Warning(location, "gain is 0. taken as 1.");
+    return 1;
+  }
+}
+
 // constructors
 /**
    Default constructor.
@@ -56,8 +125,9 @@ GraphStyle ESR::gs_sig_imag_integ = {807, 2};
  */
 ESR::ESR() :
   file_type_(-1), esr_header_(std::make_shared<ESRHeader>()),
-  file_path_(""),data_length_(-1), reduction_factor_(0),
+  file_path_(""),data_length_(-1), reduction_factor_(0), reduction_mode_(default_reduction_mode),
   xrange_{-1, -1}, yrange_{-1, -1}, date_(""), gain_(0),
+  products_(default_products), ready_(0),
   graph_(nullptr), graph_norm_(nullptr), graph_integ_(nullptr), graph_norm_integ_(nullptr),
   graph_imag_(nullptr), graph_imag_norm_(nullptr),
   graph_imag_integ_(nullptr), graph_imag_norm_integ_(nullptr)
@@ -74,10 +144,27 @@ ESR::ESR() :
    File can be text file or ROOT file.
    There are two format for text file: BOTH type is accepted.
    Raw binary data is acceptable.
+
+   If ESR::use_cache is true, parsed text file is stored in a binary sidecar
+   (file_path + ESRCache::suffix), which is loaded instead of parsing next time.
+   \code{.cpp}
+   ESR::use_cache = true;
+   ESR esr{"cofeebean-a.txt", 128}; // parse and write cofeebean-a.txt.esrcache
+   ESR esr2{"cofeebean-a.txt", 64}; // load from the sidecar
+   \endcode
+
+   Reduced data, integrals, and graphs are calculated on the first access.
+   Products given by ESR::default_products are calculated here.
+   \code{.cpp}
+   ESR::default_products = ESR::kGraphInteg & ESR::kReal;
+   ESR esr{"cofeebean-a.txt", 128}; // only integral of real part and its graph
+   \endcode
  */
 ESR::ESR(std::string file_path, int reduction_factor) :
   file_type_(-1), file_path_(file_path), data_length_(0), reduction_factor_(reduction_factor),
+  reduction_mode_(default_reduction_mode),
   xrange_{0, 0}, yrange_{0, 0}, date_(""), gain_(0),
+  products_(default_products), ready_(0),
   graph_(nullptr), graph_norm_(nullptr), graph_integ_(nullptr), graph_norm_integ_(nullptr),
   graph_imag_(nullptr), graph_imag_norm_(nullptr),
   graph_imag_integ_(nullptr), graph_imag_norm_integ_(nullptr)
@@ -101,19 +188,79 @@ ESR::ESR(std::string file_path, int reduction_factor) :
     }
   else if(file_type_ != 2) // normal, wave format, and binary file
     {
-      ifs.seekg(ifs.beg);
-      raw_header_ = std::move(ParseHeader(ifs));
-      MakeHeader(raw_header_);
-      SetParams();
-      ParseData(ifs);
+      // binary file is already mapped without parsing: no cache.
+      auto is_cachable = use_cache and file_type_ != 3;
+      if(file_type_ == 3)
+        {
+          // typed header directly. raw header map is made on request.
+          binary_header_ = std::make_shared<ESRBinaryHeader>(ifs);
+          esr_header_ = binary_header_->MakeHeader();
+          SetParams();
+          ParseData(ifs);
+        }
+      else if(not (is_cachable and LoadFromCache()))
+        {
+          ifs.seekg(ifs.beg);
+          raw_header_ = std::move(ParseHeader(ifs));
+          MakeHeader(raw_header_);
+          SetParams();
+          ParseData(ifs);
+
+          if(is_cachable)
+            WriteCache();
+        }
       ifs.close();
     }
 
-  // reduction and integral
+  // reduction and integral: only declared products
   CheckReductionFactor();
-  ReduceData();
-  IntegrateData();
-  MakeAllGraphs();
+  Materialize(products_);
+}
+
+/**
+   Constructor for a spectrum being acquired.
+
+   No data is loaded: samples are added later by Append() or Consume().
+   @param header raw header (key-value) of the measurement, may be empty.
+   "data length" and x range in the header give the x step of the sweep,
+   which is used when blocks without x are appended.
+
+   \code{.cpp}
+   ESR esr{header, 32};
+   ESRStream stream{64};
+   // acquisition thread: stream.Push(std::move(block));
+   esr.Consume(stream); // update reduced data, integral, and graphs
+   \endcode
+ */
+ESR::ESR(const std::map<std::string, std::string>& header, int reduction_factor) :
+  file_type_(-1), file_path_(""), data_length_(0), reduction_factor_(reduction_factor),
+  reduction_mode_(default_reduction_mode),
+  xrange_{0, 0}, yrange_{0, 0}, date_(""), gain_(0),
+  products_(default_products), ready_(0),
+  graph_(nullptr), graph_norm_(nullptr), graph_integ_(nullptr), graph_norm_integ_(nullptr),
+  graph_imag_(nullptr), graph_imag_norm_(nullptr),
+  graph_imag_integ_(nullptr), graph_imag_norm_integ_(nullptr)
+{
+  Info("ESR(std::map, int)", "cnstr");
+
+  raw_header_ = header;
+  MakeHeader(raw_header_);
+  SetParams();
+
+  if(gain_ == 0)
+    gain_ = 1; // no amplitude in header
+
+  // x step from header. data_length_ is the number of acquired points from now.
+  stream_dx_ = (data_length_ > 0)? (xrange_.second - xrange_.first) / data_length_ : 1;
+  data_length_ = 0;
+
+  if(reduction_factor_ <= 0)
+    {
+      Warning("ESR(std::map, int)", "reduction_factor must be greater than 0 -> 1");
+      reduction_factor_ = 1;
+    }
+
+  Materialize(products_);
 }
 
 /**
@@ -121,6 +268,9 @@ ESR::ESR(std::string file_path, int reduction_factor) :
 
    This is the practical and basic impliment.
    See the link at the move constructor.
+
+   Sample arrays are shared, not copied (copy-on-write): copying costs O(1)
+   until one of the objects changes its data. Graphs are made again on request.
  */
 ESR& ESR::operator=(const ESR& esr)
 {
@@ -143,12 +293,16 @@ ESR& ESR::operator=(const ESR& esr)
       file_path_ = esr.file_path_;
       data_length_ = esr.data_length_;
       reduction_factor_ = esr.reduction_factor_;
+      reduction_mode_ = esr.reduction_mode_;
       xrange_ = esr.xrange_;
       yrange_ = esr.yrange_;
       date_ = esr.date_;
       gain_ = esr.gain_;
+      stream_dx_ = esr.stream_dx_;
+      products_ = esr.products_;
+      ready_ = esr.ready_ & ~baseline_ready; // stage is not copied
 
-      // vector...
+      // vector... arrays are shared: copied when either object changes them.
       vxdata_ = esr.vxdata_;
       vydata_ = esr.vydata_;
       vydata_integ_ = esr.vydata_integ_;
@@ -159,37 +313,34 @@ ESR& ESR::operator=(const ESR& esr)
       vydata_imag_integ_ = esr.vydata_imag_integ_;
       vydata_imag_norm_ = esr.vydata_imag_norm_;
       vydata_imag_norm_integ_ = esr.vydata_imag_norm_integ_;
+      for(auto channel = 0; channel < 4; ++channel)
+        integ_table_[channel] = esr.integ_table_[channel];
 
       vxdata_orig_ = esr.vxdata_orig_;
       vydata_orig_ = esr.vydata_orig_;
-      vydata_norm_orig_ = esr.vydata_norm_orig_;
       vydata_imag_orig_ = esr.vydata_imag_orig_;
-      vydata_imag_norm_orig_ = esr.vydata_imag_norm_orig_;
+      raw_header_ = esr.raw_header_;
 
-      // helper function to clone graph
-      auto clone_graph = [&](const std::shared_ptr<TGraph>& gr) -> std::shared_ptr<TGraph>
-        {
-          if(not gr)
-            return nullptr;
+      // mapping and binary header are read-only: sharing is enough.
+      raw_file_ = esr.raw_file_;
+      binary_header_ = esr.binary_header_;
 
-          auto gr_new = dynamic_cast<TGraph*>(gr->Clone());
-          if(not gr_new)
+      /* graphs are not cloned: they are made from the shared arrays
+         when they are requested. */
+      ready_ &= ~(kGraph | kGraphInteg);
+      ResetGraphs();
+
+      pyramid_ = esr.pyramid_;
+      for(auto& factor_level : pyramid_)
+        {
+          auto& level = factor_level.second;
+          level.ready &= ~(kGraph | kGraphInteg);
+          for(auto channel = 0; channel < 4; ++channel)
             {
-              Error("ESR(const ESR&)", "Graph is not derived from TGraph!?!?");
-              return nullptr;
+              level.graph[channel].reset();
+              level.graph_integ[channel].reset();
             }
-          return std::shared_ptr<TGraph>(std::move(gr_new));
-        };
-
-      // clone graphs
-      graph_  = clone_graph(esr.graph_);
-      graph_norm_ = clone_graph(esr.graph_norm_);
-      graph_integ_ = clone_graph(esr.graph_integ_);
-      graph_norm_integ_ = clone_graph(esr.graph_norm_integ_);
-      graph_imag_ = clone_graph(esr.graph_imag_);
-      graph_imag_norm_ = clone_graph(esr.graph_imag_norm_);
-      graph_imag_integ_ = clone_graph(esr.graph_imag_integ_);
-      graph_imag_norm_integ_ = clone_graph(esr.graph_imag_norm_integ_);
+        }
     }
 
   return *this;
@@ -232,9 +383,13 @@ ESR& ESR::operator=(ESR&& esr) noexcept
       file_path_ = std::move(esr.file_path_);
       data_length_ = std::move(esr.data_length_);
       reduction_factor_ = std::move(esr.reduction_factor_);
+      reduction_mode_ = esr.reduction_mode_;
       xrange_ = std::move(esr.xrange_);
       yrange_ = std::move(esr.yrange_);
       gain_ = std::move(esr.gain_);
+      stream_dx_ = esr.stream_dx_;
+      products_ = esr.products_;
+      ready_ = esr.ready_;
 
       // initialize member variable at oritinal esr obj.
       esr.data_length_ = -1;
@@ -242,24 +397,32 @@ ESR& ESR::operator=(ESR&& esr) noexcept
       esr.xrange_ = {-1, -1};
       esr.yrange_ = {-1, -1};
       esr.gain_ = 0;
+      esr.ready_ = 0;
 
       // vector
       vxdata_ = std::move(esr.vxdata_);
       vydata_ = std::move(esr.vydata_);
-      vydata_integ_ = std::move(esr.vydata_norm_);
+      vydata_integ_ = std::move(esr.vydata_integ_);
+      vydata_norm_ = std::move(esr.vydata_norm_);
       vydata_norm_integ_ = std::move(esr.vydata_norm_integ_);
 
       vydata_imag_ = std::move(esr.vydata_imag_);
       vydata_imag_integ_ = std::move(esr.vydata_imag_integ_);
       vydata_imag_norm_ = std::move(esr.vydata_imag_norm_);
       vydata_imag_norm_integ_ = std::move(esr.vydata_imag_norm_integ_);
+      for(auto channel = 0; channel < 4; ++channel)
+        integ_table_[channel] = std::move(esr.integ_table_[channel]);
+      baseline_ = std::move(esr.baseline_);
+      baseline_source_ = esr.baseline_source_;
 
       // original
-      vxdata_orig_ = std::move(vxdata_orig_);
-      vydata_orig_ = std::move(vydata_orig_);
-      vydata_norm_orig_ = std::move(vydata_norm_orig_);
-      vydata_imag_orig_ = std::move(vydata_imag_orig_);
-      vydata_imag_norm_orig_ = std::move(vydata_imag_norm_orig_);
+      vxdata_orig_ = std::move(esr.vxdata_orig_);
+      vydata_orig_ = std::move(esr.vydata_orig_);
+      vydata_imag_orig_ = std::move(esr.vydata_imag_orig_);
+      raw_header_ = std::move(esr.raw_header_);
+      raw_file_ = std::move(esr.raw_file_);
+      binary_header_ = std::move(esr.binary_header_);
+      pyramid_ = std::move(esr.pyramid_);
 
       // graphs
       graph_ = std::move(esr.graph_);
@@ -443,274 +606,8 @@ std::map<std::string, std::string> ESR::ParseHeader(std::ifstream& ifs)
     }
   else if(file_type_ == 3)
     {
-      // binary format.
-      const int bsize = 1024;
-      char buf[bsize];
-
-      // helper function
-      // fill up with null char.
-      auto clear = [](char buf[], int size)->void
-        {
-          std::memset(buf, '\x00', size);
-        };
-
-      // start reading:
-      // (sorry for ugly codes...)
-      clear(buf, bsize);
-      ifs.seekg(0x00);
-      ifs.read(buf, 0x10);
-      std::string data_head_type {buf}; //cAcqu
-      header_key_val["type"] = buf;
-
-      clear(buf, bsize);
-      ifs.read(buf, 0x40);
-      std::string file_name {buf};
-      header_key_val["file name"] = file_name;
-
-      clear(buf, bsize);
-      ifs.seekg(0x56);
-      ifs.read(buf, 4);
-      auto data_size = *reinterpret_cast<int*>(buf);
-      header_key_val["data length"] = std::to_string(data_size);
-      header_key_val["length"] = std::to_string(data_size);
-
-      ifs.seekg(0x60);
-      ifs.read(buf, 0x10);
-      std::string data_sort {buf};
-      header_key_val["data sort"] = data_sort;
-
-      ifs.seekg(0x70);
-      ifs.read(buf, 0x04);
-      auto x_range_min = *reinterpret_cast<float*>(buf);
-      ifs.read(buf, 0x04);
-      auto x_range = *reinterpret_cast<float*>(buf);
-
-      header_key_val["x-range min"] = std::to_string(x_range_min);
-      header_key_val["x-range"] = std::to_string(x_range);
-
-      clear(buf, bsize);
-      ifs.read(buf, 2);
-      std::string x_unit {buf};
-      header_key_val["x unit"] = x_unit;
-
-      ifs.seekg(0xb4);
-      ifs.read(buf, 4);
-      auto x_view_min = *reinterpret_cast<float*>(buf);
-      ifs.read(buf, 4);
-      auto x_view_max = *reinterpret_cast<float*>(buf);
-      ifs.read(buf, 4);
-      auto y_view_min = *reinterpret_cast<float*>(buf);
-      ifs.read(buf, 4);
-      auto y_view_max = *reinterpret_cast<float*>(buf);
-      header_key_val["x-view min"] = std::to_string(x_view_min);
-      header_key_val["x-view max"] = std::to_string(x_view_max);
-      header_key_val["y-view min"] = std::to_string(y_view_min);
-      header_key_val["y-view max"] = std::to_string(y_view_max);
-
-      /////  next
-      ifs.seekg(0x18ac);
-      ifs.read(buf, 4);
-      std::string type {buf}; // tyFA
-      header_key_val["type"] = "tyFA"; // oh.... duplicate...
-
-      ifs.seekg(0x18fc);
-      ifs.read(buf, 0x10);
-      std::string center_field {buf};
-      header_key_val["center field"] = center_field;
-
-      clear(buf, bsize);
-      ifs.seekg(0x190c);
-      ifs.read(buf, 0x10);
-      std::string sweep1 {buf};
-      header_key_val["sweep width(fine)"] = sweep1;
-
-      clear(buf, bsize);
-      ifs.seekg(0x191c);
-      ifs.read(buf, 0x10);
-      std::string sweep2 {buf};
-      header_key_val["sweep width(coar)"] = sweep2;
-
-      clear(buf, bsize);
-      ifs.seekg(0x194c);
-      ifs.read(buf, 4);
-      std::string sweep_time {buf};
-      header_key_val["sweep time"] = sweep_time;
-
-      clear(buf, bsize);
-      ifs.seekg(0x197c);
-      ifs.read(buf, 0x10);
-      std::string sweep_control {buf};
-      header_key_val["sweep control"] = sweep_control;
-
-      ////// frequency
-      clear(buf, bsize);
-      ifs.seekg(0x1a5c);
-      ifs.read(buf, 0x10);
-      std::string mod_frq {buf};
-      header_key_val["modulation freq."] = mod_frq;
-
-      clear(buf, bsize);
-      ifs.read(buf, 0x10);
-      std::string mod_width_fine {buf};
-      header_key_val["mod. width(fine)"] = mod_width_fine;
-
-      clear(buf, bsize);
-      ifs.read(buf, 0x10);
-      std::string mod_width_coarse {buf};
-      header_key_val["mod. width(coarse)"] = mod_width_coarse;
-
-      clear(buf, bsize);
-      ifs.read(buf, 0x10);
-      std::string phase {buf};
-      header_key_val["phase"] = phase;
-
-      clear(buf, bsize);
-      ifs.read(buf, 0x10);
-      std::string receiver_mode {buf};
-      header_key_val["receiver mode"] = receiver_mode;
-
-      clear(buf, bsize);
-      ifs.read(buf, 0x10);
-      std::string phase_fine {buf};
-      header_key_val["phase (fine)"] = phase_fine;
-
-      clear(buf, bsize);
-      ifs.seekg(0x1abc);
-      ifs.read(buf, 0x10);
-      std::string amplitude_fine {buf};
-      header_key_val["amplitude(fine)"] = amplitude_fine;
-
-      clear(buf, bsize);
-      ifs.read(buf, 0x10);
-      std::string amplitude_coarse {buf};
-      header_key_val["amplitude(coarse)"] = amplitude_coarse;
-
-      clear(buf, bsize);
-      ifs.read(buf, 0x10);
-      std::string time_constant {buf};
-      header_key_val["time constant"] = time_constant;
-
-      clear(buf, bsize);
-      ifs.read(buf, 16);
-      std::string zero {buf};
-      header_key_val["zero"] = zero;
-
-      clear(buf, bsize);
-      ifs.seekg(0x1afb);
-      ifs.read(buf, 0x10);
-      std::string receiver_mode1 {buf}; // rmsecond
-      header_key_val["receiver mode2"] = receiver_mode1;
-
-      clear(buf, bsize);
-      ifs.seekg(0x1b0c);
-      ifs.read(buf, 0x10);
-      std::string phase2_fine {buf};
-      header_key_val["phase2 (fine)"] = phase2_fine;
-
-      clear(buf, bsize);
-      ifs.seekg(0x1b1c);
-      ifs.read(buf, 0x10);
-      std::string amplitude2_fine {buf};
-      header_key_val["amplitude2(fine)"] = amplitude2_fine;
-
-      clear(buf, bsize);
-      ifs.read(buf, 0x10);
-      std::string amplitude2_coarse {buf};
-      header_key_val["amplitude2(coars)"] = amplitude2_coarse;
-
-      clear(buf, bsize);
-      ifs.read(buf, 0x10);
-      std::string time_constant2 {buf};
-      header_key_val["time constant2"] = time_constant2;
-
-      // microwave
-      clear(buf, bsize);
-      ifs.seekg(0x1bec);
-      ifs.read(buf, 0x08);
-      std::string shf {buf};
-
-      clear(buf, bsize);
-      ifs.read(buf, 0x10);
-      std::string mw_frq {buf};
-      header_key_val["micro frequency"] = mw_frq;
-
-      clear(buf, bsize);
-      ifs.read(buf, 0x08);
-      std::string mw_frq_unit {buf};
-      header_key_val["micro freq. unit"] = mw_frq_unit;
-
-      clear(buf, bsize);
-      ifs.read(buf, 0x10);
-      std::string mw_power {buf};
-      header_key_val["micro power"] = mw_power;
-
-      clear(buf, bsize);
-      ifs.read(buf, 0x08);
-      std::string mw_power_unit {buf};
-      header_key_val["micro power unit"] = mw_power_unit;
-
-      clear(buf, bsize);
-      ifs.read(buf, 0x10);
-      std::string mw_phase {buf};
-      header_key_val["micro phase"] = mw_phase;
-
-      clear(buf, bsize);
-      ifs.seekg(0x1cb4);
-      ifs.read(buf, 0x08);
-      std::string gu {buf};
-      header_key_val["micro gunp"] = gu;
-
-      clear(buf, bsize);
-      ifs.read(buf, 0x08);
-      std::string re {buf};
-      header_key_val["micro ref"] = re;
-
-      clear(buf, bsize);
-      ifs.read(buf, 0x08);
-      std::string db30 {buf};
-      header_key_val["micro 30db"] = db30;
-
-      /// acq param
-      clear(buf, bsize);
-      ifs.seekg(0x1eac);
-      ifs.read(buf, 0x10);
-      std::string vt {buf};
-      header_key_val["vt type"] = vt;
-
-      clear(buf, bsize);
-      ifs.read(buf, 0x10);
-      std::string tt {&buf[0] + 2}; // skip the first two char
-      header_key_val["temperature"] = tt;
-
-      clear(buf, bsize);
-      ifs.seekg(0x1efc);
-      ifs.read(buf, 0x04);
-      std::string tu {&buf[0] + 2}; // tempr. unit
-      header_key_val["temperature unit"] = tu;
-
-      clear(buf, bsize);
-      ifs.seekg(0x205c);
-      ifs.read(buf, 0x10);
-      std::string date {buf};
-      header_key_val["date"] = date;
-
-      clear(buf, bsize);
-      ifs.seekg(0x20b8);
-      ifs.read(buf, 0x08);
-      std::string acc_mode {buf};
-      header_key_val["accumulation mode"] = acc_mode;
-
-      clear(buf, bsize);
-      ifs.seekg(0x20c0);
-      ifs.read(buf, 0x08);
-      std::string base_line {buf};
-      header_key_val["baseline"] = base_line;
-
-      clear(buf, bsize);
-      ifs.read(buf, 0x08);
-      std::string sampling_mode {buf};
-      header_key_val["sampling mode"] = sampling_mode;
-
+      // binary format: see ESRBinaryHeader for offsets of fields.
+      header_key_val = ESRBinaryHeader{ifs}.GetMap();
     }
   else
     {
@@ -732,181 +629,106 @@ void ESR::MakeHeader(const std::map<std::string, std::string>& key_val)
    parse data
 
    read as double. Original data in a file is float.
+
+   For text files, the data part is memory mapped and parsed by ESRTextParser:
+   real and imaginary blocks are parsed concurrently, each of them split into
+   chunks at line boundaries and parsed on several threads.
  */
 void ESR::ParseData(std::ifstream& ifs)
 {
-  if(file_type_ == 0)
+  // helper: report conversion error like before and re-throw
+  auto parse = [&](const char* begin, const char* end, const std::vector<double*>& cols)
     {
-      // normal
-      std::string buf;
-      std::getline(ifs, buf);
-      std::getline(ifs, buf);
-
-      // reserve buffer of vectors
-      vydata_norm_.reserve(data_length_);
-      vxdata_orig_.reserve(data_length_);
-      vydata_orig_.reserve(data_length_);
-      vydata_norm_orig_.reserve(data_length_);
-
-      // real part
-      double val = 0;
-      double dx = (xrange_.second - xrange_.first) / static_cast<double>(data_length_);
-      for(auto index = 0; index < data_length_; ++index)
+      try
         {
-          std::getline(ifs, buf);
-          val = std::stod(buf); // slightly danger..
-          try
-            {
-              val = std::stod(buf);
-            }
-          catch(std::invalid_argument& e)
-            {
-              std::cerr << "On l. " << __LINE__ << " in " << __FILE__ << ": "
-                        << "fail to convert \"" << buf << "\"" << std::endl;
-              throw e;
-            }
-          catch(std::out_of_range& e)
-            {
-              std::cerr << "On l. " << __LINE__ << " in " << __FILE__ << ": "
-                        << "fail to convert \"" << buf << "\"" << std::endl;
-              throw e;
-            }
-
-          vydata_orig_.push_back(val);
-          vydata_norm_orig_.push_back(val / gain_);
-          vxdata_orig_.push_back(xrange_.first + index * dx);
+          return ESRTextParser::Parse(begin, end, data_length_, cols);
         }
-
-      // reserve
-      vydata_imag_.reserve(data_length_);
-      vydata_imag_norm_.reserve(data_length_);
-      vydata_imag_orig_.reserve(data_length_);
-      vydata_imag_norm_orig_.reserve(data_length_);
-
-      // imaginary part
-      std::getline(ifs, buf);
-      if(buf.find("Imaginary") == buf.npos)
-        return;
-
-      for(auto index = 0; index < data_length_; ++index)
+      catch(std::invalid_argument& e)
         {
-          std::getline(ifs, buf);
-          try
-            {
-              val = std::stod(buf);
-            }
-          catch(std::invalid_argument& e)
-            {
-              std::cerr << "On l. " << __LINE__ << " in " << __FILE__ << ": "
-                        << "fail to convert \"" << buf << "\"" << std::endl;
-              throw e;
-            }
-          catch(std::out_of_range& e)
-            {
-              std::cerr << "On l. " << __LINE__ << " in " << __FILE__ << ": "
-                        << "fail to convert \"" << buf << "\"" << std::endl;
-              throw e;
-            }
-
-          vydata_imag_orig_.push_back(val);
-          vydata_imag_norm_orig_.push_back(val / gain_);
+          std::cerr << "On l. " << __LINE__ << " in " << __FILE__ << ": "
+                    << e.what() << std::endl;
+          throw;
         }
-    }
-  else if(file_type_ == 1)
+      catch(std::out_of_range& e)
+        {
+          std::cerr << "On l. " << __LINE__ << " in " << __FILE__ << ": "
+                    << e.what() << std::endl;
+          throw;
+        }
+    };
+
+  if(file_type_ == 0 or file_type_ == 1)
     {
-      // wave format
+      // skip two lines: "====== DATA ==" and "data[0..n] == Real part data =="
+      // (wave format: "===== CH1 data Wave No.1 =====" and "mT  Intensity")
       std::string buf;
       std::getline(ifs, buf);
       std::getline(ifs, buf);
 
-      // reserve buffer of vectors
-      vxdata_orig_.reserve(data_length_);
-      vydata_orig_.reserve(data_length_);
-      vydata_norm_orig_.reserve(data_length_);
-
-      auto val = 0.0;
-      for(auto il = 0; il < data_length_; ++il)
+      MappedFile mf{file_path_};
+      if(not mf.IsOpen() or ifs.tellg() < 0)
         {
-          // read x
-          ifs >> buf;
-          val = std::stod(buf);
-          try
-            {
-              val = std::stod(buf);
-            }
-          catch(std::invalid_argument& e)
-            {
-              std::cerr << "On l. " << __LINE__ << " in " << __FILE__ << ": "
-                        << "fail to convert \"" << buf << "\"" << std::endl;
-              throw e;
-            }
-          catch(std::out_of_range& e)
-            {
-              std::cerr << "On l. " << __LINE__ << " in " << __FILE__ << ": "
-                        << "fail to convert \"" << buf << "\"" << std::endl;
-              throw e;
-            }
-          vxdata_orig_.push_back(val);
-
-          // read y
-          ifs >> buf;
-          val = std::stod(buf);
-          try
-            {
-              val = std::stod(buf);
-            }
-          catch(std::invalid_argument& e)
-            {
-              std::cerr << "On l. " << __LINE__ << " in " << __FILE__ << ": "
-                        << "fail to convert \"" << buf << "\"" << std::endl;
-              throw e;
-            }
-          catch(std::out_of_range& e)
-            {
-              std::cerr << "On l. " << __LINE__ << " in " << __FILE__ << ": "
-                        << "fail to convert \"" << buf << "\"" << std::endl;
-              throw e;
-            }
-          vydata_orig_.push_back(val);
-          vydata_norm_orig_.push_back(val / gain_);
+          Error("ParseData", "fail to map %s", file_path_.c_str());
+          return;
         }
-
-      // imaginary part
-      vydata_imag_.reserve(data_length_);
-      vydata_imag_norm_.reserve(data_length_);
-      vydata_imag_orig_.reserve(data_length_);
-      vydata_imag_norm_orig_.reserve(data_length_);
-
-      std::getline(ifs, buf); // remove \n
-      std::getline(ifs, buf); // ===== CH2 data Wave No.1 =====
-      std::getline(ifs, buf); // mT            Intensity
-      for(auto il = 0; il < data_length_; ++il) /// il: index line
+      const char* data_end = mf.GetData() + mf.GetSize();
+      const char* real_begin = mf.GetData() + static_cast<std::size_t>(ifs.tellg());
+
+      // allocate all at once. imaginary part stays zero if it is missing.
+      std::vector<double> xs(file_type_ == 1? data_length_ : 0);
+      std::vector<double> ys(data_length_, 0), ys_imag(data_length_, 0);
+
+      // locate imaginary part: only line boundaries are searched here.
+      const char* line_end = data_end;
+      auto imag_begin = ESRTextParser::SkipLines(real_begin, data_end, data_length_);
+      imag_begin = ESRTextParser::FindLine(imag_begin, data_end, line_end);
+      if(file_type_ == 0)
         {
-          ifs >> buf; // dump. same as x in real part.
-          ifs >> buf;
-          try
-            {
-              val = std::stod(buf);
-            }
-          catch(std::invalid_argument& e)
-            {
-              std::cerr << "On l. " << __LINE__ << " in " << __FILE__ << ": "
-                        << "fail to convert \"" << buf << "\"" << std::endl;
-              throw e;
-            }
-          catch(std::out_of_range& e)
-            {
-              std::cerr << "On l. " << __LINE__ << " in " << __FILE__ << ": "
-                        << "fail to convert \"" << buf << "\"" << std::endl;
-              throw e;
-            }
+          // "data[0..n] ===== Imaginary part data  Index=0 ====="
+          if(std::string(imag_begin, line_end).find("Imaginary") == std::string::npos)
+            imag_begin = data_end;
+          else
+            imag_begin = ESRTextParser::SkipLines(imag_begin, data_end, 1);
+        }
+      else
+        {
+          // "===== CH2 data Wave No.1 =====" and "mT            Intensity"
+          imag_begin = ESRTextParser::SkipLines(imag_begin, data_end, 2);
+        }
 
-          vydata_imag_orig_.push_back(val);
-          vydata_imag_norm_orig_.push_back(val / gain_);
+      // columns: normal file has y only. wave format has x and y. x in CH2 is dumped.
+      std::vector<double*> real_cols, imag_cols;
+      if(file_type_ == 0)
+        {
+          real_cols = {ys.data()};
+          imag_cols = {ys_imag.data()};
+        }
+      else
+        {
+          real_cols = {xs.data(), ys.data()};
+          imag_cols = {nullptr, ys_imag.data()};
         }
 
+      // real and imaginary part in parallel
+      auto has_imag = (imag_begin != data_end);
+      std::future<const char*> imag;
+      if(has_imag)
+        imag = std::async(std::launch::async, parse, imag_begin, data_end, std::cref(imag_cols));
+      parse(real_begin, data_end, real_cols);
+      if(has_imag)
+        imag.get();
+
+      // x: uniform sweep for normal format
+      if(file_type_ == 0)
+        vxdata_orig_.SetUniform(data_length_, xrange_.first,
+                                (xrange_.second - xrange_.first) / static_cast<double>(data_length_));
+      else
+        vxdata_orig_.Assign(std::move(xs));
+      vydata_orig_.Assign(std::move(ys), float_storage);
+      vydata_imag_orig_.Assign(std::move(ys_imag), float_storage);
+
       // set parameters
-      if(data_length_ > 0)
+      if(file_type_ == 1 and data_length_ > 0)
         {
           esr_header_->GetDataHead()->SetXrangeMin(vxdata_orig_.front());
           esr_header_->GetDataHead()->SetXrange(vxdata_orig_.back() - vxdata_orig_.front());
@@ -928,49 +750,27 @@ void ESR::ParseData(std::ifstream& ifs)
        n_of_channel is normally 2: real and imaginary part.
 
        But may be this point is fixed, IMHO.
-      */
-      ifs.seekg(0x251c);
+       -> see ESRRawFile::data_offset
 
-      // reserve
-      vydata_norm_.reserve(data_length_);
-      vxdata_orig_.reserve(data_length_);
-      vydata_orig_.reserve(data_length_);
-      vydata_norm_orig_.reserve(data_length_);
-
-      // buffer
-      char buf[4]; // small..? danger?
-
-      /*
-        fortunately endian is small: no byte swap needed.
-       */
-
-      // real part
-      double val = 0;
-      double dx = (xrange_.second - xrange_.first) / static_cast<double>(data_length_);
-      for(auto index = 0; index < data_length_; ++index)
+       The file is memory mapped and channels refer float blocks in it:
+       no copy, no conversion. See also GetRawSpan().
+      */
+      raw_file_ = std::make_shared<ESRRawFile>(file_path_);
+      if(not raw_file_->IsOpen())
         {
-          ifs.read(buf, 4);
-          val = static_cast<double>(*reinterpret_cast<float*>(buf));
-
-          vydata_orig_.push_back(val);
-          vydata_norm_orig_.push_back(val / gain_);
-          vxdata_orig_.push_back(xrange_.first + index * dx);
+          Error("ParseData", "fail to map %s", file_path_.c_str());
+          raw_file_.reset();
+          data_length_ = 0;
+          return;
         }
 
-      // reserve
-      vydata_imag_.reserve(data_length_);
-      vydata_imag_norm_.reserve(data_length_);
-      vydata_imag_orig_.reserve(data_length_);
-      vydata_imag_norm_orig_.reserve(data_length_);
-
-      for(auto index = 0; index < data_length_; ++index)
-        {
-          ifs.read(buf, 4);
-          val = static_cast<double>(*reinterpret_cast<float*>(buf));  // ugly
+      if(raw_file_->GetDataLength() < data_length_)
+        data_length_ = raw_file_->GetDataLength();
 
-          vydata_imag_orig_.push_back(val);
-          vydata_imag_norm_orig_.push_back(val / gain_);
-        }
+      vydata_orig_.Assign(raw_file_->GetY(false).subspan(0, data_length_), raw_file_);
+      vydata_imag_orig_.Assign(raw_file_->GetY(true).subspan(0, data_length_), raw_file_);
+      vxdata_orig_.SetUniform(data_length_, xrange_.first,
+                              (xrange_.second - xrange_.first) / static_cast<double>(data_length_));
     }
   else
     {
@@ -980,10 +780,28 @@ void ESR::ParseData(std::ifstream& ifs)
 
 /**
    Load data from ROOT file.
+
+   Two layouts are accepted:
+   - version 2: one-entry TTree "spectrum" (see ESR::Write)
+   - version 1: TTree "header" of pair<string, string> and TTree "data" of one sample per entry
  */
 void ESR::LoadFromROOTFile()
 {
   auto tf = std::unique_ptr<TFile>(TFile::Open(file_path_.c_str()));
+  if(not tf or tf->IsZombie())
+    {
+      Error("LoadFromROOTFile", "fail to open %s", file_path_.c_str());
+      return;
+    }
+
+  auto tree_spectrum = dynamic_cast<TTree*>(tf->Get("spectrum"));
+  if(tree_spectrum)
+    {
+      LoadFromROOTTree(tree_spectrum);
+      tf->Close();
+      return;
+    }
+
   auto tree_header = dynamic_cast<TTree*>(tf->Get("header"));
   auto tree_data = dynamic_cast<TTree*>(tf->Get("data"));
 
@@ -995,7 +813,7 @@ void ESR::LoadFromROOTFile()
     }
 
   // read header
-  std::pair<std::string, std::string>* pinfo;
+  std::pair<std::string, std::string>* pinfo = nullptr;
   tree_header->SetBranchAddress("info", &pinfo);
   for(auto ient = 0ll, nent = tree_header->GetEntries(); ient < nent; ++ient)
     {
@@ -1014,205 +832,526 @@ void ESR::LoadFromROOTFile()
   tree_data->SetBranchAddress("y_imag_norm", &y_imag_norm);
 
   // data_length_ already set. here resize method is preferable.
-  vxdata_orig_.resize(data_length_);
-  vydata_orig_.resize(data_length_);
-  vydata_norm_orig_.resize(data_length_);
-  vydata_imag_orig_.resize(data_length_);
-  vydata_imag_norm_orig_.resize(data_length_);
+  // normalised data are dropped: y / gain.
+  std::vector<double> xs(data_length_), ys(data_length_), ys_imag(data_length_);
 
-  for(auto ient = 0ll, nent = tree_data->GetEntries(); ient < nent; ++ient)
+  auto nent = std::min<long long>(tree_data->GetEntries(), data_length_);
+  for(auto ient = 0ll; ient < nent; ++ient)
     {
       tree_data->GetEntry(ient);
-      vxdata_orig_.at(ient) = x;
-      vydata_orig_.at(ient) = y_real;
-      vydata_norm_orig_.at(ient) = y_real_norm;
-      vydata_imag_orig_.at(ient) = y_imag;
-      vydata_imag_norm_orig_.at(ient) = y_imag_norm;
+      xs[ient] = x;
+      ys[ient] = y_real;
+      ys_imag[ient] = y_imag;
     }
+  vxdata_orig_.Assign(std::move(xs));
+  vydata_orig_.Assign(std::move(ys), float_storage);
+  vydata_imag_orig_.Assign(std::move(ys_imag), float_storage);
 
   // close
   tf->Close();
 }
 
-
 /**
-   Reading from internal header file, setting parameters.
+   Load data from TTree "spectrum" (layout version 2).
+
+   Every channel is one array in the single entry, read in bulk by TTreeReaderArray.
+   Normalised data are not stored and calculated from gain.
  */
-void ESR::SetParams()
+void ESR::LoadFromROOTTree(TTree* tree)
 {
-  data_length_ = esr_header_->GetDataLength();
-  date_ = esr_header_->GetDate();
+  // what is stored?
+  bool is_float = false;
+  {
+    TTreeReader reader(tree);
+    TTreeReaderValue<int> version(reader, "version");
+    TTreeReaderValue<bool> rv_is_float(reader, "is_float");
+    TTreeReaderValue<std::string> header(reader, "header");
+    if(not reader.Next())
+      {
+        Error("LoadFromROOTTree", "TTree \"spectrum\" is empty.");
+        return;
+      }
+    if(*version > root_format_version_max)
+      Warning("LoadFromROOTTree", "format version %d is newer than %d",
+              *version, root_format_version_max);
+
+    is_float = *rv_is_float;
+    raw_header_ = DeserializeHeader(*header);
+  }
+  MakeHeader(raw_header_);
+  SetParams();
 
-  xrange_ = esr_header_->GetXrange();
-  yrange_ = esr_header_->GetYrange();
+  // x is double also in float files. Older float files have float x.
+  auto branch_x = tree->GetBranch("x");
+  auto is_x_float = (branch_x and std::string{branch_x->GetClassName()} == "vector<float>");
 
-  auto amp1s = esr_header_->GetAmplitude(1);
-  gain_ = amp1s.first * std::pow(10, amp1s.second);
-}
+  // helper: copy arrays, x of type X and y of type T
+  auto read = [&](auto x_tag, auto tag)
+    {
+      using X = decltype(x_tag);
+      using T = decltype(tag);
+      TTreeReader reader(tree);
+      TTreeReaderArray<X> xs(reader, "x");
+      TTreeReaderArray<T> ys(reader, "y");
+      TTreeReaderArray<T> ys_imag(reader, "y_imag");
+      if(not reader.Next())
+        return;
 
+      auto n = std::min<std::size_t>(xs.GetSize(), data_length_);
+      std::vector<double> vx(n), vy(n), vy_imag(n);
+      for(auto i = 0ul; i < n; ++i)
+        {
+          vx[i] = xs[i];
+          vy[i] = ys[i];
+          vy_imag[i] = ys_imag[i];
+        }
+      vxdata_orig_.Assign(std::move(vx));
+      vydata_orig_.Assign(std::move(vy), float_storage);
+      vydata_imag_orig_.Assign(std::move(vy_imag), float_storage);
+    };
 
-/**
-   reduce data points.
+  vxdata_orig_.Clear();
+  if(is_float and is_x_float)
+    read(float{}, float{});
+  else if(is_float)
+    read(double{}, float{});
+  else
+    read(double{}, double{});
 
-   Original data is kept and unchanged by this operation.
-   Calculating a mean value of all data points of which the number is reduction factor,
-   make new vectors.
-   （reduction factorで指定したデータ点の平均値をとり，vectorを作成し直す．）
+  data_length_ = vxdata_orig_.GetSize();
+}
+
+/**
+   serialize header map into one string: "<key length>:<key><value length>:<value>..."
  */
-void ESR::ReduceData()
+std::string ESR::SerializeHeader(const std::map<std::string, std::string>& key_val)
 {
-  // reduction
-  std::vector<double> vxdata_red_, vydata_red_, vydata_norm_red_,
-                      vydata_imag_red_, vydata_imag_norm_red_;
+  std::string blob;
+  for(auto& kv : key_val)
+    {
+      blob += std::to_string(kv.first.size()) + ":" + kv.first;
+      blob += std::to_string(kv.second.size()) + ":" + kv.second;
+    }
+  return blob;
+}
 
-  // reserve size
-  vxdata_red_.reserve(data_length_ + 1);
-  vydata_red_.reserve(data_length_ + 1);
-  vydata_norm_red_.reserve(data_length_ + 1);
-  vydata_imag_red_.reserve(data_length_ + 1);
-  vydata_imag_norm_red_.reserve(data_length_ + 1);
+/**
+   inverse of SerializeHeader. Broken tail is ignored with warning.
+ */
+std::map<std::string, std::string> ESR::DeserializeHeader(const std::string& blob)
+{
+  std::map<std::string, std::string> key_val;
 
-  for(auto i = 0, n = data_length_; i < n; i += reduction_factor_)
+  std::size_t pos = 0;
+  auto next = [&](std::string& s) -> bool
     {
-      /* data reduction
-         o take mean every 'reduction_factor' time.
-      */
-      auto nsize = 0.0;
-      auto xsum = 0.0, ysum = 0.0, ynormsum = 0.0, yimagsum = 0.0, yimagnormsum = 0.0;
-      for(auto j = 0; j < reduction_factor_; ++j)
+      auto colon = blob.find(':', pos);
+      if(colon == std::string::npos)
+        return false;
+      std::size_t len = 0;
+      try
         {
-          auto index = i + j;
-          if(index >= data_length_)
-            continue;
-
-          xsum += vxdata_orig_.at(index);
-          ysum += vydata_orig_.at(index);
-          ynormsum += vydata_norm_orig_.at(index);
-          yimagsum += vydata_imag_orig_.at(index);
-          yimagnormsum += vydata_imag_norm_orig_.at(index);
-
-          ++nsize;
+          len = std::stoul(blob.substr(pos, colon - pos));
+        }
+      catch(std::exception&)
+        {
+          return false;
         }
+      if(colon + 1 + len > blob.size())
+        return false;
+      s = blob.substr(colon + 1, len);
+      pos = colon + 1 + len;
+      return true;
+    };
 
-      vxdata_red_.push_back(xsum / nsize);
-      vydata_red_.push_back(ysum / nsize);
-      vydata_norm_red_.push_back(ynormsum / nsize);
-      vydata_imag_red_.push_back(yimagsum / nsize);
-      vydata_imag_norm_red_.push_back(yimagnormsum / nsize);
+  std::string key, val;
+  while(pos < blob.size())
+    {
+      if(not (next(key) and next(val)))
+        {
+          ::Warning("ESR::DeserializeHeader", "header blob is broken at %zu", pos);
+          break;
+        }
+      key_val[key] = val;
     }
 
-  // shrink
-  vxdata_red_.shrink_to_fit();
-  vydata_red_.shrink_to_fit();
-  vydata_norm_red_.shrink_to_fit();
-  vydata_imag_red_.shrink_to_fit();
-  vydata_imag_norm_red_.shrink_to_fit();
-
-  // move
-  vxdata_ = std::move(vxdata_red_);
-  vydata_ = std::move(vydata_red_);
-  vydata_norm_ = std::move(vydata_norm_red_);
-  vydata_imag_ = std::move(vydata_imag_red_);
-  vydata_imag_norm_ = std::move(vydata_imag_norm_red_);
+  return key_val;
 }
 
+
 /**
-   integrating data, which is reduced.
+   Load header and data from binary sidecar written by WriteCache.
 
-   Internally, this calls DoIntegral function.
+   @return false if the sidecar is missing, stale or inconsistent with its header.
+   Nothing is changed then.
  */
-void ESR::IntegrateData()
+bool ESR::LoadFromCache()
 {
-  vydata_integ_ = std::move(DoIntegral(vxdata_, vydata_,
-                                       xrange_.first, xrange_.second).second);
-  vydata_norm_integ_ = std::move(DoIntegral(vxdata_, vydata_norm_,
-                                            xrange_.first, xrange_.second).second);
-  vydata_imag_integ_ = std::move(DoIntegral(vxdata_, vydata_imag_,
-                                            xrange_.first, xrange_.second).second);
-  vydata_imag_norm_integ_ = std::move(DoIntegral(vxdata_, vydata_imag_norm_,
-                                                 xrange_.first, xrange_.second).second);
+  ESRCache cache{file_path_};
+  if(not cache.IsValid() or cache.GetFileType() != file_type_)
+    return false;
+
+  // check the header against the data before anything is replaced
+  auto header = std::make_shared<ESRHeader>(cache.GetHeader());
+  if(static_cast<std::size_t>(header->GetDataLength()) != cache.GetDataLength())
+    {
+      Warning("LoadFromCache", "data length inconsistent. -> parse file");
+      return false;
+    }
+
+  raw_header_ = cache.GetHeader();
+  esr_header_ = header;
+  SetParams();
+
+  auto xs = cache.GetX();
+  auto ys = cache.GetY(false);
+  auto ys_imag = cache.GetY(true);
+  vxdata_orig_.Assign(std::vector<double>(xs.begin(), xs.end()));
+  vydata_orig_.Assign(std::vector<double>(ys.begin(), ys.end()), float_storage);
+  vydata_imag_orig_.Assign(std::vector<double>(ys_imag.begin(), ys_imag.end()), float_storage);
+
+  // same as ParseData: wave format takes x range from data
+  if(file_type_ == 1 and data_length_ > 0)
+    {
+      esr_header_->GetDataHead()->SetXrangeMin(vxdata_orig_.front());
+      esr_header_->GetDataHead()->SetXrange(vxdata_orig_.back() - vxdata_orig_.front());
+      SetParams();
+    }
+
+  Info("LoadFromCache", "loaded from %s", ESRCache::GetCachePath(file_path_).c_str());
+  return true;
 }
 
 /**
-   make all graphs by calling MakeGraph function.
+   write binary sidecar. Failure is not fatal: only warning is printed.
+ */
+void ESR::WriteCache() const
+{
+  ESRCache::Write(file_path_, file_type_, GetRawHeader(), vxdata_orig_.ToVector(),
+                  vydata_orig_.ToVector(), vydata_imag_orig_.ToVector());
+}
 
-   * raw signal
-   * raw signal normalised by "normalise factor"
-   * integrated raw signal
-   * integrated raw signal normalised
 
-   Graphs for imaginary part are also created.
+/**
+   Reading from internal header file, setting parameters.
  */
-void ESR::MakeAllGraphs()
+void ESR::SetParams()
 {
-  // graphs
-  graph_.reset(MakeGraph(vxdata_, vydata_));
-  graph_norm_.reset(MakeGraph(vxdata_, vydata_norm_));
-  graph_integ_.reset(MakeGraph(vxdata_, vydata_integ_));
-  graph_norm_integ_.reset(MakeGraph(vxdata_, vydata_norm_integ_));
-  //  imaginary
-  graph_imag_.reset(MakeGraph(vxdata_, vydata_imag_));
-  graph_imag_norm_.reset(MakeGraph(vxdata_, vydata_imag_norm_));
-  graph_imag_integ_.reset(MakeGraph(vxdata_, vydata_imag_integ_));
-  graph_imag_norm_integ_.reset(MakeGraph(vxdata_, vydata_imag_norm_integ_));
+  data_length_ = esr_header_->GetDataLength();
+  date_ = esr_header_->GetDate();
+
+  xrange_ = esr_header_->GetXrange();
+  yrange_ = esr_header_->GetYrange();
 
-  // makeup real
-  MakeupGraph(graph_, gs_sig, "");
-  MakeupGraph(graph_norm_, gs_sig, "");
-  MakeupGraph(graph_integ_, gs_sig_integ, "");
-  MakeupGraph(graph_norm_integ_, gs_sig_integ, "");
-  // makeup imaginary
-  MakeupGraph(graph_imag_, gs_sig_imag, "");
-  MakeupGraph(graph_imag_norm_, gs_sig_imag, "");
-  MakeupGraph(graph_imag_integ_, gs_sig_imag_integ, "");
-  MakeupGraph(graph_imag_norm_integ_, gs_sig_imag_integ, "");
+  auto amp1s = esr_header_->GetAmplitude(1);
+  gain_ = amp1s.first * std::pow(10, amp1s.second);
 }
 
+
 /**
-   check reduction factor and correct if necessary.
+   channel index of data: 0, 1, 2, 3 for real, normalised, imaginary,
+   and normalised imaginary part. Product bits of a channel are ESR::kReal << channel.
  */
-void ESR::CheckReductionFactor()
+int ESR::Channel(bool is_norm, bool is_imag) {return (is_imag? 2 : 0) + (is_norm? 1 : 0);}
+
+/**
+   original samples of channel. Normalised channels (1, 3) share
+   samples with 0, 2: divide them by gain_.
+ */
+const ESRChannel& ESR::GetOrig(int channel) const
 {
-  if(data_length_ <= 0)
+  return (channel >= 2)? vydata_imag_orig_ : vydata_orig_;
+}
+
+ESRBuffer<double>& ESR::GetReduced(int channel) const
+{
+  switch(channel)
     {
-      Warning("CheckReductionFactor", "data length is invalid.");
-      reduction_factor_ = 1;
+    case 1: return vydata_norm_;
+    case 2: return vydata_imag_;
+    case 3: return vydata_imag_norm_;
+    default: return vydata_;
     }
+}
 
-  if(reduction_factor_ <= 0 )
+ESRBuffer<double>& ESR::GetInteg(int channel) const
+{
+  switch(channel)
     {
-      Warning("CheckReductionFactor", "reduction_factor must be greater than 0");
-      reduction_factor_ = 1;
-      Warning("ESR::CheckReductionFactor", "-> force to use %d", reduction_factor_);
+    case 1: return vydata_norm_integ_;
+    case 2: return vydata_imag_integ_;
+    case 3: return vydata_imag_norm_integ_;
+    default: return vydata_integ_;
     }
+}
 
-  if(reduction_factor_ > data_length_)
+std::shared_ptr<TGraph>& ESR::GetGraphRef(int channel, bool is_integ) const
+{
+  switch(channel)
     {
-      Warning("CheckReductionFactor",
-              "reduction_factor must be less than data_length (%d)", data_length_);
-      reduction_factor_ = data_length_;
-      Warning("CheckReductionFactor", "-> force to use %d", reduction_factor_);
+    case 1: return is_integ? graph_norm_integ_ : graph_norm_;
+    case 2: return is_integ? graph_imag_integ_ : graph_imag_;
+    case 3: return is_integ? graph_imag_norm_integ_ : graph_imag_norm_;
+    default: return is_integ? graph_integ_ : graph_;
     }
 }
 
 /**
-   check whether file exists or not
+   prefix table of integral of reduced data, made on the first call.
+   Shares arrays with reduced data. Forgotten when reduced data changes.
  */
-bool ESR::CheckInputFile(std::ifstream& ifs)
+const ESRIntegralTable& ESR::GetIntegTable(int channel) const
 {
-  if(ifs.fail())
+  Materialize(kData & (kReal << channel));
+  if(not (ready_ & (table_ready << channel)))
     {
-      Error("CheckInputFile", "File open error");
-      return false;
+      integ_table_[channel] = ESRIntegralTable{vxdata_, GetReduced(channel)};
+      ready_ |= table_ready << channel;
     }
-  return true;
+  return integ_table_[channel];
 }
 
 /**
-   check file format. File type info is stored in the variable file_type_.
+   calculate products (ESR::Product bits) not calculated yet.
+   Products which the requested ones depend on are also calculated:
+   graph -> reduced data, integral -> reduced data, graph of integral -> integral.
+ */
+void ESR::Materialize(unsigned products) const
+{
+  if(reduction_factor_ <= 0) // no data loaded
+    return;
 
-   -1: other file
-    0: converted text file (80 lines header and data part)
+  products |= (products & kGraph) >> 8;
+  products |= (products & kGraphInteg) >> 8;
+  products |= (products & kInteg) >> 4;
+
+  auto todo = products & kAll & ~ready_;
+  if(todo & kData)
+    {
+      ReduceData(0, todo & kData);
+      ready_ |= todo & kData;
+    }
+  if(todo & kInteg)
+    {
+      IntegrateData((todo & kInteg) >> 4);
+      ready_ |= todo & kInteg;
+    }
+  if(todo & (kGraph | kGraphInteg))
+    {
+      MakeAllGraphs(todo & (kGraph | kGraphInteg));
+      ready_ |= todo & (kGraph | kGraphInteg);
+    }
+}
+
+/**
+   forget all products: they are calculated again on the next access.
+   Graphs already returned are kept alive by their owners.
+ */
+void ESR::ResetProducts()
+{
+  ready_ = 0;
+  ResetGraphs();
+  for(auto& table : integ_table_)
+    table = ESRIntegralTable{};
+  baseline_ = ESRBaseline{};
+}
+
+void ESR::ResetGraphs()
+{
+  for(auto channel = 0; channel < 4; ++channel)
+    {
+      GetGraphRef(channel, false).reset();
+      GetGraphRef(channel, true).reset();
+    }
+}
+
+/**
+   decimator of reduction_factor_ and reduction_mode_. It is kept between
+   ReduceData() calls (e.g. Append()) with the windows at both ends cached in it.
+ */
+const ESRDecimator& ESR::GetDecimator() const
+{
+  if(not decimator_ or decimator_->GetFactor() != reduction_factor_
+     or decimator_->GetMode() != reduction_mode_)
+    decimator_.reset(new ESRDecimator{reduction_factor_, reduction_mode_});
+  return *decimator_;
+}
+
+/**
+   reduce data points.
+
+   Original data is kept and unchanged by this operation.
+   Calculating a mean value of all data points of which the number is reduction factor,
+   make new vectors.
+   （reduction factorで指定したデータ点の平均値をとり，vectorを作成し直す．）
+   y is reduced by ESRDecimator with reduction_mode_ (boxcar mean by default);
+   x is always the mean: the centre of every group.
+
+   @param first_bin reduced points before this index are kept as they are.
+   Append() gives the first bin affected by new samples so that only those are calculated.
+   @param channels bit mask of channels to be reduced (bit i: channel i, see Channel()).
+   x is reduced together unless it is already.
+ */
+void ESR::ReduceData(int first_bin, unsigned channels) const
+{
+  int nbin = ESRDecimator::GetNbin(data_length_, reduction_factor_);
+  if(first_bin < 0)
+    first_bin = 0;
+
+  auto prepare = [&](ESRBuffer<double>& buf) -> double*
+    {
+      if(first_bin == 0)
+        buf.Assign(std::vector<double>(nbin)); // fresh: not shared, no capacity left.
+      else
+        buf.Mutable().resize(nbin);
+      return buf.Mutable().data();
+    };
+
+  if(not (ready_ & x_ready))
+    {
+      auto out = prepare(vxdata_);
+      for(auto ibin = first_bin; ibin < nbin; ++ibin)
+        {
+          auto begin = ibin * reduction_factor_;
+          auto end = std::min(begin + reduction_factor_, data_length_);
+          auto sum = 0.0;
+          for(auto index = begin; index < end; ++index)
+            sum += vxdata_orig_[index];
+          out[ibin] = sum / static_cast<double>(end - begin);
+        }
+    }
+
+  /* all channels in one pass of the decimator.
+     channels stored as double and as float are given separately. */
+  std::vector<const double*> ins;
+  std::vector<const float*> ins_float;
+  std::vector<double> divisors, divisors_float;
+  std::vector<double*> outs, outs_float;
+  for(auto channel = 0; channel < 4; ++channel)
+    {
+      if(not (channels & (1u << channel)))
+        continue;
+
+      auto out = prepare(GetReduced(channel));
+      auto divisor = (channel % 2 == 1)? gain_ : 1.0;
+      GetOrig(channel).Visit([&](auto ys)
+        {
+          if constexpr (std::is_same<decltype(ys), const float*>::value)
+            {
+              ins_float.push_back(ys);
+              divisors_float.push_back(divisor);
+              outs_float.push_back(out);
+            }
+          else
+            {
+              ins.push_back(ys);
+              divisors.push_back(divisor);
+              outs.push_back(out);
+            }
+        });
+    }
+
+  const auto& decimator = GetDecimator();
+  if(not ins.empty())
+    decimator.Decimate(data_length_, ins, divisors, outs, first_bin);
+  if(not ins_float.empty())
+    decimator.Decimate(data_length_, ins_float, divisors_float, outs_float, first_bin);
+
+  ready_ |= x_ready;
+}
+
+/**
+   integrating data, which is reduced.
+
+   Internally, this calls DoIntegral function.
+   @param channels bit mask of channels (see ReduceData).
+ */
+void ESR::IntegrateData(unsigned channels) const
+{
+  for(auto channel = 0; channel < 4; ++channel)
+    {
+      if(channels & (1u << channel))
+        GetInteg(channel).Assign(std::move(DoIntegral(vxdata_.Get(), GetReduced(channel).Get(),
+                                                      xrange_.first, xrange_.second).second));
+    }
+}
+
+/**
+   make graphs by calling MakeGraph function.
+
+   * raw signal
+   * raw signal normalised by "normalise factor"
+   * integrated raw signal
+   * integrated raw signal normalised
+
+   Graphs for imaginary part are also created.
+   @param products graph bits (ESR::kGraph, ESR::kGraphInteg) to be made.
+ */
+void ESR::MakeAllGraphs(unsigned products) const
+{
+  for(auto channel = 0; channel < 4; ++channel)
+    {
+      auto is_imag = channel >= 2;
+      if(products & kGraph & (kReal << channel))
+        {
+          auto& gr = GetGraphRef(channel, false);
+          gr.reset(MakeGraph(vxdata_.Get(), GetReduced(channel).Get()));
+          MakeupGraph(gr, is_imag? gs_sig_imag : gs_sig, "");
+        }
+      if(products & kGraphInteg & (kReal << channel))
+        {
+          auto& gr = GetGraphRef(channel, true);
+          gr.reset(MakeGraph(vxdata_.Get(), GetInteg(channel).Get()));
+          MakeupGraph(gr, is_imag? gs_sig_imag_integ : gs_sig_integ, "");
+        }
+    }
+}
+
+/**
+   check reduction factor and correct if necessary.
+ */
+void ESR::CheckReductionFactor()
+{
+  if(data_length_ <= 0)
+    {
+      Warning("CheckReductionFactor", "data length is invalid.");
+      reduction_factor_ = 1;
+    }
+
+  if(reduction_factor_ <= 0 )
+    {
+      Warning("CheckReductionFactor", "reduction_factor must be greater than 0");
+      reduction_factor_ = 1;
+      Warning("ESR::CheckReductionFactor", "-> force to use %d", reduction_factor_);
+    }
+
+  if(reduction_factor_ > data_length_)
+    {
+      Warning("CheckReductionFactor",
+              "reduction_factor must be less than data_length (%d)", data_length_);
+      reduction_factor_ = data_length_;
+      Warning("CheckReductionFactor", "-> force to use %d", reduction_factor_);
+    }
+}
+
+/**
+   check whether file exists or not
+ */
+bool ESR::CheckInputFile(std::ifstream& ifs)
+{
+  if(ifs.fail())
+    {
+      Error("CheckInputFile", "File open error");
+      return false;
+    }
+  return true;
+}
+
+/**
+   check file format. File type info is stored in the variable file_type_.
+
+   -1: other file
+    0: converted text file (80 lines header and data part)
     1: 'wave format' file (approx. 5 lines header and two columns data part)
     2: ROOT file created by ESR::Write() function.
     3: raw binary file
@@ -1300,20 +1439,27 @@ ESR::DoIntegral(const std::vector<double>& xs, const std::vector<double>& ys,
       return std::make_pair(std::vector<double>{}, std::vector<double>{});
     }
 
-  if((start < xrange_.first) or (end > xrange_.second))
-    {
-      Warning("DoIntegral",
-              "Invalid integral range: it must be within %.3f to %.3f",
-              xrange_.first, xrange_.second);
-      return std::make_pair(std::vector<double>{}, std::vector<double>{});
-    }
+  if(not CheckIntegralRange(start, end))
+    return std::make_pair(std::vector<double>{}, std::vector<double>{});
 
-  if(start > end)
+  if(std::is_sorted(xs.cbegin(), xs.cend()))
     {
-      Warning("DoIntegral", "star > end ==> swap them");
-      std::swap(start, end);
+      // points within [start, end] and the one before: contiguous
+      std::size_t first = std::lower_bound(xs.cbegin(), xs.cend(), start) - xs.cbegin();
+      std::size_t last = std::upper_bound(xs.cbegin(), xs.cend(), end) - xs.cbegin();
+      first = std::max<std::size_t>(first, 1);
+      if(first >= last)
+        return std::make_pair(std::vector<double>{}, std::vector<double>{});
+
+      auto np = last - first + 1;
+      std::vector<double> xs_new(xs.cbegin() + (first - 1), xs.cbegin() + last), ys_integ(np);
+      auto y0 = integral_constant.first? integral_constant.second : ys[first - 1];
+      ESRIntegrator::Trapezoid(xs.data() + (first - 1), ys.data() + (first - 1), np,
+                               ys_integ.data(), nullptr, y0);
+      return std::make_pair(std::move(xs_new), std::move(ys_integ));
     }
 
+  // x not in order: points out of range are skipped one by one.
   std::vector<double> xs_new, ys_integ;
 
   // reserve
@@ -1353,23 +1499,84 @@ ESR::DoIntegral(const std::vector<double>& xs, const std::vector<double>& ys,
 }
 
 
+/**
+   check integral range: it must be within x range. start and end are swapped if start > end.
+ */
+bool ESR::CheckIntegralRange(double& start, double& end) const
+{
+  if((start < xrange_.first) or (end > xrange_.second))
+    {
+      Warning("DoIntegral",
+              "Invalid integral range: it must be within %.3f to %.3f",
+              xrange_.first, xrange_.second);
+      return false;
+    }
+
+  if(start > end)
+    {
+      Warning("DoIntegral", "star > end ==> swap them");
+      std::swap(start, end);
+    }
+  return true;
+}
+
 /**
    create a graph integrated partially.
 
+   Points are taken from the prefix table (see GetYIntegPart()).
+
    @return shared_ptr of TGraph
  */
 std::shared_ptr<TGraph> ESR::GetGraphIntegPart(double start, double end,
                                                const std::pair<bool, double> integral_constant,
                                                bool is_norm, bool is_imag) const
 {
-  const std::vector<double>* pvy;
-  if(is_imag)
-    pvy = is_norm? &vydata_imag_norm_ : &vydata_imag_;
-  else
-    pvy = is_norm? &vydata_norm_ : &vydata_;
+  auto channel = Channel(is_norm, is_imag);
+  if(not GetIntegTable(channel).IsSorted())
+    {
+      auto vxy = std::move(this->DoIntegral(vxdata_.Get(), GetReduced(channel).Get(),
+                                            start, end, integral_constant));
+      return std::shared_ptr<TGraph>(MakeGraph(vxy.first, vxy.second));
+    }
+
+  auto part = GetYIntegPart(start, end, integral_constant, is_norm, is_imag);
+  auto gr = std::make_shared<TGraph>(static_cast<int>(part.size()));
+  for(auto i = 0ul; i < part.size(); ++i)
+    gr->SetPoint(i, part.x[i], part[i]);
+  return gr;
+}
 
-  auto vxy = std::move(this->DoIntegral(vxdata_, *pvy, start, end, integral_constant));
-  return std::shared_ptr<TGraph>(MakeGraph(vxy.first, vxy.second));
+/**
+   integral within [start, end] as a view: the same points as GetGraphIntegPart(),
+   which are the running integral from the last point before start
+   (initial value: integral_constant or y of that point).
+
+   No new array: the view is an offset of the prefix table. O(log n).
+   The view is valid until reduced data changes (SetReductionFactor, Append, ...).
+   Empty if x is not in ascending order.
+ */
+ESRIntegralTable::View ESR::GetYIntegPart(double start, double end,
+                                          const std::pair<bool, double> integral_constant,
+                                          bool is_norm, bool is_imag) const
+{
+  auto channel = Channel(is_norm, is_imag);
+  const auto& table = GetIntegTable(channel);
+  if(not table.IsSorted())
+    {
+      Warning("GetYIntegPart", "x is not in ascending order.");
+      return {};
+    }
+  if(not CheckIntegralRange(start, end))
+    return {};
+
+  // points first - 1 ... last - 1, as DoIntegral()
+  auto range = table.FindRange(start, end);
+  auto first = std::max<std::size_t>(range.first, 1), last = range.second;
+  if(first >= last)
+    return {};
+
+  auto y0 = integral_constant.first? integral_constant.second : GetReduced(channel)[first - 1];
+  return table.GetView(first - 1, last, y0 - table.GetCumulative(first - 1));
 }
 
 
@@ -1407,37 +1614,682 @@ void ESR::MakeupGraph(const std::shared_ptr<TGraph>& gr,
 }
 
 
+/**
+   append samples acquired after the last call.
+
+   Only the affected part is updated: the last (partial) reduced bin and new bins,
+   the running trapezoidal integral from the first updated bin, and the tail of graphs.
+   Cost is proportional to the block size, not to the whole spectrum.
+
+   @param x field of samples. If empty, x continues with the step given by header.
+   @param y_imag imaginary part. If empty, zeros are used.
+ */
+void ESR::Append(const std::vector<double>& y, const std::vector<double>& y_imag,
+                 const std::vector<double>& x)
+{
+  if(y.empty())
+    return;
+  if((not x.empty() and x.size() != y.size()) or (not y_imag.empty() and y_imag.size() != y.size()))
+    {
+      Warning("Append", "size of x, y, and y_imag inconsistent. ignored.");
+      return;
+    }
+
+  // levels and tables would be shared and out of date: reduced data would be copied on update.
+  ClearPyramid();
+  ready_ &= ~(table_ready_all | baseline_ready);
+  for(auto& table : integ_table_)
+    table = ESRIntegralTable{};
+  baseline_ = ESRBaseline{};
+
+  auto nold = data_length_;
+  auto nnew = nold + static_cast<int>(y.size());
+  if(x.empty())
+    vxdata_orig_.AppendUniform(y.size(), xrange_.first, stream_dx_);
+  else
+    vxdata_orig_.Append(x.data(), x.size());
+  vydata_orig_.Append(y.data(), y.size());
+  if(y_imag.empty())
+    {
+      std::vector<double> zeros(y.size(), 0);
+      vydata_imag_orig_.Append(zeros.data(), zeros.size());
+    }
+  else
+    vydata_imag_orig_.Append(y_imag.data(), y_imag.size());
+  data_length_ = nnew;
+
+  // integral range must cover acquired data.
+  if(nold == 0 and xrange_.first == xrange_.second)
+    xrange_.first = vxdata_orig_.front();
+  xrange_.first = std::min(xrange_.first, vxdata_orig_[nold]);
+  xrange_.second = std::max(xrange_.second, vxdata_orig_.back());
+
+  // nothing calculated yet: all products are calculated on the first access.
+  if(not (ready_ & kAll))
+    {
+      ready_ = 0;
+      return;
+    }
+
+  /* the last bin may be partial: recalculate from it.
+     FIR and Savitzky-Golay windows reach over neighbouring groups:
+     bins whose window covers the old end are recalculated, too. */
+  auto extent = GetDecimator().GetExtent();
+  auto first_bin = (extent == 0)? nold / reduction_factor_
+    : std::max(0, (nold - extent) / reduction_factor_ - 1);
+  ready_ &= ~x_ready;
+  ReduceData(first_bin, ready_ & kData);
+  IntegrateTail(first_bin);
+  UpdateGraphs(first_bin);
+}
+
+/**
+   Append all blocks queued in stream.
+
+   @return number of blocks appended.
+ */
+int ESR::Consume(ESRStream& stream)
+{
+  ESRBlock block;
+  auto nblock = 0;
+  while(stream.Pop(block))
+    {
+      Append(block.y, block.y_imag, block.x);
+      ++nblock;
+    }
+  return nblock;
+}
+
+/**
+   running trapezoidal integral of reduced data from the reduced index 'from'.
+   Same as IntegrateData for spectrum within x range.
+   Only integrals already calculated are updated.
+ */
+void ESR::IntegrateTail(std::size_t from)
+{
+  auto integ = [&](const std::vector<double>& ys, std::vector<double>& ys_integ)
+    {
+      auto n = ys.size();
+      ys_integ.resize(n);
+      if(n == 0)
+        return;
+      // restart from the last point kept
+      auto begin = (from == 0)? 0 : std::min(from, n) - 1;
+      auto y0 = (from == 0)? ys[0] : ys_integ[begin];
+      ESRIntegrator::Trapezoid(vxdata_.GetData() + begin, ys.data() + begin, n - begin,
+                               ys_integ.data() + begin, nullptr, y0);
+    };
+
+  for(auto channel = 0; channel < 4; ++channel)
+    {
+      if(ready_ & kInteg & (kReal << channel))
+        integ(GetReduced(channel).Get(), GetInteg(channel).Mutable());
+    }
+}
+
+/**
+   set points of graphs from the reduced index 'from'.
+   TGraph::SetPoint expands its buffer geometrically: appending is amortized O(1).
+   Only graphs already made are updated.
+ */
+void ESR::UpdateGraphs(std::size_t from)
+{
+  auto update = [&](const std::shared_ptr<TGraph>& gr, const std::vector<double>& ys)
+    {
+      for(auto i = from, n = ys.size(); i < n; ++i)
+        gr->SetPoint(i, vxdata_[i], ys[i]);
+    };
+
+  for(auto channel = 0; channel < 4; ++channel)
+    {
+      if(ready_ & kGraph & (kReal << channel))
+        update(GetGraphRef(channel, false), GetReduced(channel).Get());
+      if(ready_ & kGraphInteg & (kReal << channel))
+        update(GetGraphRef(channel, true), GetInteg(channel).Get());
+    }
+}
+
+
 /**
    Set new reduction factor.
-   Data and graphs are updated.
+   Data and graphs are recalculated on the next access (declared products: now).
+  If the pyramid has the factor (see BuildPyramid()), its products are used
+  without calculation, and the current products are kept in the pyramid.
  */
 void ESR::SetReductionFactor(int reduction_factor)
 {
+  StoreLevel();
+
   reduction_factor_ = reduction_factor;
   CheckReductionFactor();
 
-  // recalculate data
-  ReduceData();
-  IntegrateData();
-  MakeAllGraphs();
+  ResetProducts();
+  LoadLevel();
+  Materialize(products_);
 }
 
 /**
-   calculate integrated value.
+   Set kind of data reduction (see ESRDecimator).
+   Data and graphs are recalculated on the next access (declared products: now).
+   \code{.cpp}
+   ESR esr{"cofeebean-a.txt", 128};
+   esr.SetReductionMode(ESRDecimator::kFIR); // anti-aliased, narrow lines are kept
+   \endcode
+ */
+void ESR::SetReductionMode(ESRDecimator::Mode mode)
+{
+  reduction_mode_ = mode;
+  ClearPyramid(); // boxcar only
+
+  ResetProducts();
+  Materialize(products_);
+}
 
+ESRDecimator::Mode ESR::GetReductionMode() const {return reduction_mode_;}
 
+/**
+   denoise spectra in place without reduction of points (see ESRDenoiser).
+
+   @param mode ESRDenoiser::kGaussian, kLorentzian or kWavelet
+   @param width sigma or HWHM in unit of x (FFT low-pass),
+   or threshold in unit of the universal threshold (wavelet)
+   @param is_orig true: original data. Reduced data are made again from them,
+   and denoised data are kept over SetReductionFactor().
+   false: reduced data (all channels). Integrals and graphs are made again;
+   SetReductionFactor() and Append() make reduced data from original one again.
+ */
+void ESR::Denoise(ESRDenoiser::Mode mode, double width, bool is_orig)
+{
+  if(reduction_factor_ <= 0) // no data loaded
+    return;
+
+  ESRDenoiser den{mode, width};
+  ClearPyramid();
+  if(is_orig)
+    {
+      auto n = vydata_orig_.GetSize();
+      auto dx = (n > 1)? (vxdata_orig_.back() - vxdata_orig_.front()) / (n - 1) : 0.0;
+      auto ys = vydata_orig_.ToVector();
+      auto ys_imag = vydata_imag_orig_.ToVector();
+      den.Apply(ys.data(), (ys_imag.size() == n)? ys_imag.data() : nullptr, n, dx);
+      vydata_orig_.Assign(std::move(ys), vydata_orig_.IsFloat());
+      if(ys_imag.size() == n)
+        vydata_imag_orig_.Assign(std::move(ys_imag), vydata_imag_orig_.IsFloat());
+
+      ResetProducts();
+      Materialize(products_);
+      return;
+    }
+
+  Materialize(kData);
+  const auto& xs = vxdata_.Get();
+  auto n = xs.size();
+  auto dx = (n > 1)? (xs.back() - xs.front()) / (n - 1) : 0.0;
+  for(auto is_norm : {false, true}) // real and imaginary parts by one transform
+    {
+      auto& re = GetReduced(Channel(is_norm, false)).Mutable();
+      auto& im = GetReduced(Channel(is_norm, true)).Mutable();
+      den.Apply(re.data(), (im.size() == re.size())? im.data() : nullptr, re.size(), dx);
+    }
+
+  // reduced data are kept: products made from them are not
+  ready_ &= kData | x_ready;
+  ResetGraphs();
+  for(auto& table : integ_table_)
+    table = ESRIntegralTable{};
+  baseline_ = ESRBaseline{};
+  Materialize(products_);
+}
+
+/**
+   original channels = self_weight * own + sum of weights[k] * others[k].
+
+   Others on a different x axis are interpolated onto the own axis by
+   ESRResampler (arithmetic_interpolation). Points out of their range get
+   ESRResampler::out_of_range (0). All products are made again.
+ */
+void ESR::Combine(double self_weight, const std::vector<const ESR*>& others,
+                  const std::vector<double>& weights)
+{
+  if(reduction_factor_ <= 0) // no data loaded
+    return;
+
+  auto n = vydata_orig_.GetSize();
+  auto has_imag = (vydata_imag_orig_.GetSize() == n);
+  std::vector<double> re(n, 0), im(has_imag? n : 0, 0);
+  if(self_weight != 0)
+    {
+      accumulate(re, vydata_orig_, self_weight);
+      if(has_imag)
+        accumulate(im, vydata_imag_orig_, self_weight);
+    }
+
+  std::vector<double> xs; // own axis, made when an other axis differs
+  for(std::size_t k = 0; k < others.size(); ++k)
+    {
+      const auto& other = *others[k];
+      auto other_has_imag = (other.vydata_imag_orig_.GetSize() == other.vydata_orig_.GetSize());
+      if(vxdata_orig_.IsSame(other.vxdata_orig_))
+        {
+          accumulate(re, other.vydata_orig_, weights[k]);
+          if(has_imag and other_has_imag)
+            accumulate(im, other.vydata_imag_orig_, weights[k]);
+          continue;
+        }
+
+      if(xs.empty())
+        xs = vxdata_orig_.ToVector();
+      ESRResampler rs{xs, ESRResampler::kField, arithmetic_interpolation};
+      auto table = rs.MakeTable(other.vxdata_orig_.ToVector());
+      auto nout = std::count(table.first.cbegin(), table.first.cend(), ESRResampler::npos);
+      if(nout > 0)
+        Warning("Combine", "%ld of %zu points out of x range of %s.", static_cast<long>(nout), n,
+                other.file_path_.c_str());
+      accumulate(re, ESRResampler::Apply(table, other.vydata_orig_.ToVector()), weights[k]);
+      if(has_imag and other_has_imag)
+        accumulate(im, ESRResampler::Apply(table, other.vydata_imag_orig_.ToVector()), weights[k]);
+    }
+
+  AssignOrig(std::move(re), std::move(im));
+}
+
+/**
+   replace original channels (same number of points) and make all products again.
+   Imaginary part is kept if y_imag is empty. Storage (double or float) is kept.
+ */
+void ESR::AssignOrig(std::vector<double>&& y, std::vector<double>&& y_imag)
+{
+  ClearPyramid();
+  vydata_orig_.Assign(std::move(y), vydata_orig_.IsFloat());
+  if(not y_imag.empty())
+    vydata_imag_orig_.Assign(std::move(y_imag), vydata_imag_orig_.IsFloat());
+  ResetProducts();
+  Materialize(products_);
+}
+
+/**
+   add weight * other to original data (as measured: gains are not matched).
+   Accumulation count in the header is the sum of both.
+   Other x axis is interpolated onto this one.
+
+   \code{.cpp}
+   ESR sum{"scan1.txt"};
+   sum += ESR{"scan2.txt"};
+   \endcode
+ */
+ESR& ESR::Add(const ESR& other, double weight)
+{
+  Combine(1, {&other}, {weight});
+  if(esr_header_ and esr_header_->GetAcquisitionParameter())
+    esr_header_->SetAccumulationCount(std::max(1, GetAccumulationCount())
+                                      + std::max(1, other.GetAccumulationCount()));
+  return *this;
+}
+
+/** subtract weight * other from original data (as measured: gains are not matched). */
+ESR& ESR::Subtract(const ESR& other, double weight)
+{
+  Combine(1, {&other}, {-weight});
+  return *this;
+}
+
+/**
+   gain-normalised difference: subtract weight * reference measured at other gain,
+   y - weight * (gain / gain of reference) * y_reference, so that y / gain is
+   the difference of normalised data. E.g. blank tube or cavity background.
+   A gain of 0 is taken as 1 with a warning.
+ */
+ESR& ESR::SubtractNormalized(const ESR& reference, double weight)
+{
+  Combine(1, {&reference},
+          {-weight * matching_gain(*this, "ESR::SubtractNormalized")
+              / matching_gain(reference, "ESR::SubtractNormalized")});
+  return *this;
+}
+
+/** multiply original data by factor. Gain is kept. */
+ESR& ESR::Scale(double factor)
+{
+  Combine(factor, {}, {});
+  return *this;
+}
+
+/**
+   weighted average of spectra: new ESR with header, gain, and x axis of the first one.
+   Gains are matched: the average is of normalised data, multiplied by the first gain.
+   A gain of 0 is taken as 1 with a warning.
+   Accumulation count is the sum. Other x axes are interpolated onto the first.
+
+   @param weights one per spectrum, e.g. 1 / sigma^2. Equal weights if empty.
+ */
+ESR ESR::Average(const std::vector<const ESR*>& spectra, const std::vector<double>& weights)
+{
+  if(spectra.empty() or std::count(spectra.cbegin(), spectra.cend(), nullptr) > 0)
+    {
+      ::Error("ESR::Average", "no spectrum or null spectrum given.");
+      return ESR{};
+    }
+  if(not weights.empty() and weights.size() != spectra.size())
+    {
+      ::Error("ESR::Average", "number of weights %zu differs from spectra %zu.", weights.size(), spectra.size());
+      return ESR{};
+    }
+
+  auto sum = weights.empty()? static_cast<double>(spectra.size())
+    : std::accumulate(weights.cbegin(), weights.cend(), 0.0);
+  if(sum == 0)
+    {
+      ::Error("ESR::Average", "sum of weights is 0.");
+      return ESR{};
+    }
+
+  ESR average{*spectra.front()};
+  auto gain = matching_gain(average, "ESR::Average");
+  std::vector<double> ws(spectra.size());
+  auto count = 0;
+  for(std::size_t k = 0; k < spectra.size(); ++k)
+    {
+      ws[k] = (weights.empty()? 1.0 : weights[k]) / sum * gain / matching_gain(*spectra[k], "ESR::Average");
+      count += std::max(1, spectra[k]->GetAccumulationCount());
+    }
+  average.Combine(0, spectra, ws);
+  if(average.esr_header_ and average.esr_header_->GetAcquisitionParameter())
+    average.esr_header_->SetAccumulationCount(count);
+  return average;
+}
+
+ESR& ESR::operator+=(const ESR& other) {return Add(other);}
+ESR& ESR::operator-=(const ESR& other) {return Subtract(other);}
+ESR& ESR::operator*=(double factor) {return Scale(factor);}
+
+/** sum in new buffers: arrays of a are shared until the sum is written. */
+ESR operator+(const ESR& a, const ESR& b)
+{
+  ESR sum{a};
+  sum += b;
+  return sum;
+}
+
+ESR operator-(const ESR& a, const ESR& b)
+{
+  ESR diff{a};
+  diff -= b;
+  return diff;
+}
+
+ESR operator*(const ESR& a, double factor)
+{
+  ESR scaled{a};
+  scaled *= factor;
+  return scaled;
+}
+
+ESR operator*(double factor, const ESR& a) {return a * factor;}
+
+/**
+   build reduced data at reduction factors 1, 2, 4, ..., max_factor at once.
+
+   Every level is made from the previous one (sums of two bins), so the cost
+   is about two passes over the original data. Afterwards SetReductionFactor()
+   to any of these factors only swaps arrays: integrals and graphs made at a
+   level are kept there, too.
+   Only for boxcar reduction. Means are summed pairwise: they can differ from
+   ReduceData() by rounding. Memory is about twice of the reduced data at factor 1.
+   Append() and SetReductionMode() clear the pyramid.
+
+   \code{.cpp}
+   ESR esr{"cofeebean-a.txt", 128};
+   esr.BuildPyramid(128);
+   esr.SetReductionFactor(32); // no calculation
+   esr.GetGraphInteg();        // integral at 32 is calculated and kept
+   esr.SetReductionFactor(128);
+   \endcode
+ */
+void ESR::BuildPyramid(int max_factor)
+{
+  if(data_length_ <= 0)
+    {
+      Warning("BuildPyramid", "no data.");
+      return;
+    }
+  if(reduction_mode_ != ESRDecimator::kBoxcar)
+    {
+      Warning("BuildPyramid", "only for boxcar reduction. ignored.");
+      return;
+    }
+
+  pyramid_.clear();
+
+  // sums of level 1 are the original points.
+  auto xs = vxdata_orig_.ToVector();
+  auto ys = vydata_orig_.ToVector();
+  auto ys_imag = vydata_imag_orig_.ToVector();
+  std::size_t n = data_length_;
+  for(auto factor = 1; factor <= max_factor and factor <= data_length_; factor *= 2)
+    {
+      if(factor > 1)
+        {
+          auto nbin = (n + 1) / 2;
+          for(auto sums : {&xs, &ys, &ys_imag})
+            {
+              auto& v = *sums;
+              for(std::size_t ibin = 0; ibin < nbin; ++ibin)
+                v[ibin] = (2 * ibin + 1 < n)? v[2 * ibin] + v[2 * ibin + 1] : v[2 * ibin];
+              v.resize(nbin);
+            }
+          n = nbin;
+        }
+
+      // last bin may be partial.
+      auto last = static_cast<double>(data_length_ - (n - 1) * factor);
+      auto mean = [&](const std::vector<double>& sums, double divisor)
+        {
+          std::vector<double> vals(n);
+          for(std::size_t ibin = 0; ibin < n; ++ibin)
+            vals[ibin] = sums[ibin] / (ibin + 1 < n? factor : last) / divisor;
+          return vals;
+        };
+
+      auto& level = pyramid_[factor];
+      level.x.Assign(mean(xs, 1));
+      level.y[Channel(false, false)].Assign(mean(ys, 1));
+      level.y[Channel(true, false)].Assign(mean(ys, gain_));
+      level.y[Channel(false, true)].Assign(mean(ys_imag, 1));
+      level.y[Channel(true, true)].Assign(mean(ys_imag, gain_));
+      level.ready = kData | x_ready;
+    }
+
+  // current products from the pyramid, too.
+  ResetProducts();
+  LoadLevel();
+  Materialize(products_);
+}
+
+/**
+   forget the pyramid. Current products are kept.
+ */
+void ESR::ClearPyramid()
+{
+  pyramid_.clear();
+}
+
+/**
+   keep current products in the pyramid level of the current factor, if any.
+ */
+void ESR::StoreLevel()
+{
+  auto it = pyramid_.find(reduction_factor_);
+  if(it == pyramid_.end())
+    return;
+
+  auto& level = it->second;
+  level.ready = ready_ & ~(table_ready_all | baseline_ready); // tables are made again
+  level.x = vxdata_;
+  for(auto channel = 0; channel < 4; ++channel)
+    {
+      level.y[channel] = GetReduced(channel);
+      level.y_integ[channel] = GetInteg(channel);
+      level.graph[channel] = GetGraphRef(channel, false);
+      level.graph_integ[channel] = GetGraphRef(channel, true);
+    }
+}
+
+/**
+   take products of the current factor from the pyramid.
+   @return false if the pyramid does not have the factor.
+ */
+bool ESR::LoadLevel()
+{
+  auto it = pyramid_.find(reduction_factor_);
+  if(it == pyramid_.end())
+    return false;
+
+  const auto& level = it->second;
+  ready_ = level.ready;
+  vxdata_ = level.x;
+  for(auto channel = 0; channel < 4; ++channel)
+    {
+      GetReduced(channel) = level.y[channel];
+      GetInteg(channel) = level.y_integ[channel];
+      GetGraphRef(channel, false) = level.graph[channel];
+      GetGraphRef(channel, true) = level.graph_integ[channel];
+    }
+  return true;
+}
+
+/**
+   declare products calculated in advance (ESR::Product bits).
+   Products not declared are still calculated on the first access.
+ */
+void ESR::SetProducts(unsigned products)
+{
+  products_ = products;
+  Materialize(products_);
+}
+
+unsigned ESR::GetProducts() const {return products_;}
+
+/**
+   calculate integrated value.
+
+   Sum of the running integral on the points of GetGraphIntegPart().
+   Answered from the prefix table of integral in O(log n): no walk over data.
  */
 double ESR::Integrate(double start, double end, bool is_norm, bool is_imag,
                       const std::pair<bool, double> integral_constant) const
 {
-  const std::vector<double>* pvy; // Pointer of Vector Y
-  if(is_imag)
-    pvy = is_norm? &vydata_imag_norm_ : &vydata_imag_;
-  else
-    pvy = is_norm? &vydata_norm_ : &vydata_;
+  auto channel = Channel(is_norm, is_imag);
+  const auto& table = GetIntegTable(channel);
+  if(not table.IsSorted())
+    {
+      const auto vxy = std::move(this->DoIntegral(vxdata_.Get(), GetReduced(channel).Get(),
+                                                  start, end, integral_constant));
+      return std::accumulate(vxy.second.cbegin(), vxy.second.cend(), double{0});
+    }
+
+  if(not CheckIntegralRange(start, end))
+    return 0;
+
+  /* sum of the running integral on points first - 1 ... last - 1:
+     npts * (y0 - cumul[first - 1]) + sum of cumul. */
+  auto range = table.FindRange(start, end);
+  auto first = std::max<std::size_t>(range.first, 1), last = range.second;
+  if(first >= last)
+    return 0;
+
+  auto y0 = integral_constant.first? integral_constant.second : GetReduced(channel)[first - 1];
+  auto npts = static_cast<double>(last - first + 1);
+  return npts * (y0 - table.GetCumulative(first - 1)) + table.GetSumCumulative(first - 1, last);
+}
+
+/**
+   definite integral of reduced data from start to end (trapezoid).
+   Reduced data is interpolated linearly at both edges. O(log n) with the prefix table.
+   \code{.cpp}
+   for(auto x0 = 320.0; x0 < 350; x0 += 0.1)
+     areas.push_back(esr.GetDefiniteIntegral(x0, x0 + 0.5));
+   \endcode
+ */
+double ESR::GetDefiniteIntegral(double start, double end, bool is_norm, bool is_imag) const
+{
+  const auto& table = GetIntegTable(Channel(is_norm, is_imag));
+  if(not table.IsSorted())
+    {
+      Warning("GetDefiniteIntegral", "x is not in ascending order.");
+      return 0;
+    }
+  return table.GetDefinite(start, end);
+}
+
+/**
+   baseline subtraction stage on reduced data (is_integ: on integral), made on the first call.
+   Shares arrays with reduced data. Forgotten when reduced data changes.
+ */
+ESRBaseline& ESR::GetBaselineStage(bool is_integ, bool is_norm, bool is_imag) const
+{
+  auto channel = Channel(is_norm, is_imag);
+  auto source = channel + (is_integ? 4 : 0);
+  Materialize((is_integ? kInteg : kData) & (kReal << channel));
+  if(not (ready_ & baseline_ready) or baseline_source_ != source)
+    {
+      baseline_ = ESRBaseline{vxdata_, is_integ? GetInteg(channel) : GetReduced(channel)};
+      baseline_source_ = source;
+      ready_ |= baseline_ready;
+    }
+  return baseline_;
+}
+
+/**
+   subtract polynomial fitted to points in background regions (a < x < b).
+   A replacement of TF1 "pol2" fit to a TGraph of background points.
+
+   @return corrected signal of all points, valid until the next subtraction.
+   Not subtracted (empty coefficients) if points are too few.
+ */
+Span<double> ESR::SubtractPolynomialBaseline(const std::vector<std::pair<double, double> >& regions,
+                                             int order, bool is_integ, bool is_norm, bool is_imag) const
+{
+  auto& stage = GetBaselineStage(is_integ, is_norm, is_imag);
+  return stage.SubtractPolynomial(stage.FitPolynomial(regions, order));
+}
+
+/**
+   subtract automatic baseline by asymmetric least squares (see ESRBaseline).
+   @return corrected signal of all points, valid until the next subtraction.
+ */
+Span<double> ESR::SubtractALSBaseline(double lambda, double asymmetry, int niter,
+                                      bool is_integ, bool is_norm, bool is_imag) const
+{
+  return GetBaselineStage(is_integ, is_norm, is_imag).SubtractALS(lambda, asymmetry, niter);
+}
+
+/**
+   create a graph of the last baseline-corrected signal within [start, end].
+   Empty if no subtraction is done on current reduced data.
+ */
+std::shared_ptr<TGraph> ESR::GetGraphBaselineCorrected(double start, double end) const
+{
+  if(not (ready_ & baseline_ready) or baseline_.GetCorrected().size() != baseline_.GetSize())
+    {
+      Warning("GetGraphBaselineCorrected", "no baseline subtracted.");
+      return std::make_shared<TGraph>();
+    }
+
+  auto range = baseline_.FindRange(start, end);
+  auto n = static_cast<int>(range.second - range.first);
+  if(n == 0)
+    return std::make_shared<TGraph>();
+  return std::make_shared<TGraph>(n, baseline_.GetX().data() + range.first,
+                                  baseline_.GetCorrected().data() + range.first);
+}
 
-  const auto vxy = std::move(this->DoIntegral(vxdata_, *pvy, start, end, integral_constant));
-  return std::accumulate(vxy.second.cbegin(), vxy.second.cend(), double{0});
+/**
+   find lines (zero crossings), noise and signal/background windows of reduced data.
+   Linear time: see ESRFeatureDetector.
+ */
+ESRFeatureDetector ESR::DetectFeatures(bool is_norm, bool is_imag) const
+{
+  return ESRFeatureDetector{GetXSpan(), GetYSpan(is_norm, is_imag)};
 }
 
 
@@ -1459,6 +2311,17 @@ int ESR::GetFileType() const {return file_type_;};
  */
 std::shared_ptr<ESRHeader> ESR::GetHeader() const {return esr_header_;}
 
+/**
+   raw header as key-value map.
+   For binary file, the map is made from the binary header at the first call.
+ */
+const std::map<std::string, std::string>& ESR::GetRawHeader() const
+{
+  if(raw_header_.empty() and binary_header_)
+    raw_header_ = binary_header_->GetMap();
+  return raw_header_;
+}
+
 std::pair<double, double> ESR::GetXrange() const {return esr_header_->GetXrange();}
 
 std::pair<double, double> ESR::GetYrange() const {return esr_header_->GetYrange();}
@@ -1505,6 +2368,28 @@ time_t ESR::GetDateAsUT() const
  */
 double ESR::GetGain() const {return gain_;};
 
+/** accumulation count in the header (0 if not given). */
+int ESR::GetAccumulationCount() const
+{
+  if(not esr_header_ or not esr_header_->GetAcquisitionParameter())
+    return 0;
+  return esr_header_->GetAcquisitionParameter()->GetAccumulationCount();
+}
+
+/** microwave frequency in MHz (from the header). 0 if not given. */
+double ESR::GetFrequency() const
+{
+  if(not esr_header_ or not esr_header_->GetSpectrometerParameter())
+    return 0;
+  auto mw = esr_header_->GetSpectrometerParameter()->GetMW();
+  auto freq = mw.freq;
+  if(mw.freq_unit == "kHz")
+    freq /= 1000.0;
+  else if(mw.freq_unit == "GHz")
+    freq *= 1000.0;
+  return freq;
+}
+
 /**
    return shared pointer of graph
    Four kinds of graphs returned:
@@ -1519,11 +2404,11 @@ double ESR::GetGain() const {return gain_;};
  */
 std::shared_ptr<TGraph> ESR::GetGraph(bool is_norm, bool is_imag) const
 {
+  auto channel = Channel(is_norm, is_imag);
+  Materialize(kGraph & (kReal << channel));
+
   // Here, internal counter of shared_ptr is incremented !
-  if(is_imag)
-    return is_norm? graph_imag_norm_ : graph_imag_;
-  else
-    return is_norm? graph_norm_ : graph_;
+  return GetGraphRef(channel, false);
 };
 
 /**
@@ -1535,28 +2420,86 @@ std::shared_ptr<TGraph> ESR::GetGraph(bool is_norm, bool is_imag) const
  */
 std::shared_ptr<TGraph> ESR::GetGraphInteg(bool is_norm, bool is_imag) const
 {
-  if(is_imag)
-    return is_norm? graph_imag_norm_integ_ : graph_imag_integ_;
-  else
-    return is_norm? graph_norm_integ_ : graph_integ_;
+  auto channel = Channel(is_norm, is_imag);
+  Materialize(kGraphInteg & (kReal << channel));
+  return GetGraphRef(channel, true);
 }
 
 /**
    return a copy of vector x.
  */
-std::vector<double> ESR::GetX() const {return vxdata_;};
+std::vector<double> ESR::GetX() const
+{
+  if(reduction_factor_ > 0 and not (ready_ & x_ready))
+    ReduceData(0, 0);
+  return vxdata_.Get();
+};
 
 /**
-   return a copy of vector y. By changing inputs, four kinds of data returned.
+   return a copy of vector y. By changing inputs, four kinds of data returned
+   (same as GetGraph).
  */
 std::vector<double> ESR::GetY(bool is_norm, bool is_imag) const
 {
-  if(is_imag)
-    return is_norm? vydata_norm_ : vydata_;
-  else
-    return is_norm? vydata_norm_integ_ : vydata_integ_;
+  auto channel = Channel(is_norm, is_imag);
+  Materialize(kData & (kReal << channel));
+  return GetReduced(channel).Get();
 };
 
+/**
+   read-only views of reduced x, y, and integrated y, without copy.
+   They are valid until the data of this object is changed
+   (SetReductionFactor, Append, ...) or this object is deleted.
+   Use GetX/GetY to keep data.
+ */
+Span<double> ESR::GetXSpan() const
+{
+  if(reduction_factor_ > 0 and not (ready_ & x_ready))
+    ReduceData(0, 0);
+  return vxdata_.GetSpan();
+}
+
+Span<double> ESR::GetYSpan(bool is_norm, bool is_imag) const
+{
+  auto channel = Channel(is_norm, is_imag);
+  Materialize(kData & (kReal << channel));
+  return GetReduced(channel).GetSpan();
+}
+
+Span<double> ESR::GetYIntegSpan(bool is_norm, bool is_imag) const
+{
+  auto channel = Channel(is_norm, is_imag);
+  Materialize(kInteg & (kReal << channel));
+  return GetInteg(channel).GetSpan();
+}
+
+/**
+   original samples (not reduced, not normalised). No copy:
+   e.g. ESRData is made from them without parsing the file again.
+ */
+const ESRChannel& ESR::GetOrigChannel(bool is_imag) const {return GetOrig(is_imag? 2 : 0);}
+
+/** x of original samples. */
+const ESRAxis& ESR::GetOrigAxis() const {return vxdata_orig_;}
+
+/**
+   return memory mapped raw binary file.
+   nullptr unless the file type is 3 (raw binary file).
+ */
+std::shared_ptr<ESRRawFile> ESR::GetRawFile() const {return raw_file_;}
+
+/**
+   return read-only view of original float data in raw binary file. No copy.
+   Empty span is returned for other file types.
+   Valid as long as this object (or the returned GetRawFile()) lives.
+ */
+Span<float> ESR::GetRawSpan(bool is_imag) const
+{
+  if(not raw_file_)
+    return Span<float>{};
+  return raw_file_->GetY(is_imag);
+}
+
 /**
    print x and y range.
  */
@@ -1579,6 +2522,7 @@ void ESR::Print(Option_t*) const
   std::cout << "file path: " << file_path_ << std::endl
             << "data length: " << data_length_ << std::endl
             << "reduction factor: " << reduction_factor_ << std::endl
+            << "reduction mode: " << reduction_mode_ << std::endl
             << "gain: " << gain_ << std::endl;
 
   PrintRange();
@@ -1587,7 +2531,19 @@ void ESR::Print(Option_t*) const
 
 /**
   write data into root file.
-  Two TTrees are created: info and data.
+
+  Layout is chosen by ESR::root_format_version.
+
+  Version 2 (default): one TTree "spectrum" with a single entry.
+  - version (int), is_float (bool)
+  - header (std::string): raw header serialized by SerializeHeader
+  - x, y, y_imag: whole channel as std::vector<double>
+    (y and y_imag as std::vector<float> if ESR::root_float_storage is true.
+     x stays double: a float-rounded sweep is no longer uniform in ESRAxis)
+  Normalised data are not stored: they are y / gain.
+  Compression is set by ESR::root_compression (see TFile::SetCompressionSettings).
+
+  Version 1: two TTrees, header and data.
   In the former, the raw header info are stored as pair<string, string>.
   In the letter, x, Re(y), Im(y), Re(normalised y), and Im(normalised y) are stored as double.
 
@@ -1597,6 +2553,54 @@ void ESR::Print(Option_t*) const
 Int_t ESR::Write(const char* name, Int_t, Int_t) const
 {
   auto f = std::shared_ptr<TFile>(TFile::Open(name, "recreate"));
+  if(not f or f->IsZombie())
+    {
+      Error("Write", "fail to create %s", name);
+      return 0;
+    }
+  f->SetCompressionSettings(root_compression);
+
+  if(root_format_version >= 2)
+    {
+      auto tree = new TTree("spectrum", "spectrum");
+      // `- binded by TFile, deleted by Close(). do not use smart pointer.
+
+      int version = 2;
+      bool is_float = root_float_storage;
+      auto header = SerializeHeader(GetRawHeader());
+      tree->Branch("version", &version, "version/I");
+      tree->Branch("is_float", &is_float, "is_float/O");
+      tree->Branch("header", &header);
+
+      // copy is needed: Branch takes non-const pointer.
+      std::vector<double> vx = vxdata_orig_.ToVector(), vy, vy_imag;
+      std::vector<float> fy, fy_imag;
+      tree->Branch("x", &vx);
+      if(is_float)
+        {
+          auto assign = [](std::vector<float>& fs, const std::vector<double>& ds)
+            {
+              fs.assign(ds.begin(), ds.end());
+            };
+          assign(fy, vydata_orig_.ToVector());
+          assign(fy_imag, vydata_imag_orig_.ToVector());
+          tree->Branch("y", &fy);
+          tree->Branch("y_imag", &fy_imag);
+        }
+      else
+        {
+          vy = vydata_orig_.ToVector();
+          vy_imag = vydata_imag_orig_.ToVector();
+          tree->Branch("y", &vy);
+          tree->Branch("y_imag", &vy_imag);
+        }
+      tree->Fill();
+
+      auto fsize = tree->Write();
+      f->Close();
+      return fsize;
+    }
+
   auto tree_header = new TTree("header", "header");
   auto tree_data = new TTree("data", "data");
   // `- do not use smart pointer for TTree...
@@ -1607,7 +2611,7 @@ Int_t ESR::Write(const char* name, Int_t, Int_t) const
   /* Accessing with pyROOT is no problem.*/
   std::pair<std::string, std::string> row;
   tree_header->Branch("info", &row);
-  for(auto& pr : raw_header_)
+  for(auto& pr : GetRawHeader())
     {
       row = pr;
       tree_header->Fill();
@@ -1623,11 +2627,11 @@ Int_t ESR::Write(const char* name, Int_t, Int_t) const
 
   for(auto i = 0; i < data_length_; ++i)
     {
-      x = vxdata_orig_.at(i);
-      y_real = vydata_orig_.at(i);
-      y_real_norm = vydata_norm_orig_.at(i);
-      y_imag = vydata_imag_orig_.at(i);
-      y_imag_norm = vydata_imag_norm_orig_.at(i);
+      x = vxdata_orig_[i];
+      y_real = vydata_orig_[i];
+      y_real_norm = y_real / gain_;
+      y_imag = vydata_imag_orig_[i];
+      y_imag_norm = y_imag / gain_;
 
       tree_data->Fill();
     }
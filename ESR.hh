@@ -9,12 +9,25 @@
 #include <map>
 
 #include "TObject.h"
+#include "Span.hh"
+#include "ESRAxis.hh"
+#include "ESRChannel.hh"
+#include "ESRBuffer.hh"
+#include "ESRDecimator.hh"
+#include "ESRDenoiser.hh"
+#include "ESRIntegralTable.hh"
+#include "ESRBaseline.hh"
+#include "ESRFeatureDetector.hh"
+#include "ESRResampler.hh"
 
 
 // forward declaration
 class TGraph;
 class TTree;
 class ESRHeader;
+class ESRRawFile;
+class ESRBinaryHeader;
+class ESRStream;
 
 // typedef: useless...
 using pgraph = std::shared_ptr<TGraph>;
@@ -58,50 +71,90 @@ class ESR : public TObject
 {
   static int nlines_header_txt_file;
 
+  friend class ESRAccumulator; // replaces original data by the mean of scans
+
 protected:
   int file_type_;
   std::shared_ptr<ESRHeader> esr_header_;
 
-  std::map<std::string, std::string> raw_header_;
+  // raw header. For binary file, made from binary_header_ on request: see GetRawHeader().
+  mutable std::map<std::string, std::string> raw_header_;
+  std::shared_ptr<ESRBinaryHeader> binary_header_; //!
   std::string file_path_;
   int data_length_;
   int reduction_factor_;
+  ESRDecimator::Mode reduction_mode_; //! boxcar, FIR, or Savitzky-Golay
+  mutable std::unique_ptr<ESRDecimator> decimator_; //! of reduction_factor_ and reduction_mode_, not copied
   std::pair<double, double> xrange_;
   std::pair<double, double> yrange_;
   std::string date_;
   double gain_; // amplitude(fine) * 10^(amplitude(course) )
 
+  /* derived data (reduced, integrated, and graphs) are calculated lazily
+     on the first access and memoized: see Materialize().
+     ready_ keeps which products are already calculated.
+   */
+  unsigned products_; // declared products, calculated by constructor
+  mutable unsigned ready_; //!
+
+  /* arrays are shared with copies of this object (copy-on-write). */
   // real part
-  std::vector<double> vxdata_;
-  std::vector<double> vydata_;
-  std::vector<double> vydata_integ_;
-  std::vector<double> vydata_norm_;
-  std::vector<double> vydata_norm_integ_;
+  mutable ESRBuffer<double> vxdata_; //!
+  mutable ESRBuffer<double> vydata_; //!
+  mutable ESRBuffer<double> vydata_integ_; //!
+  mutable ESRBuffer<double> vydata_norm_; //!
+  mutable ESRBuffer<double> vydata_norm_integ_; //!
 
   // imaginary part
-  std::vector<double> vydata_imag_;
-  std::vector<double> vydata_imag_integ_;
-  std::vector<double> vydata_imag_norm_;
-  std::vector<double> vydata_imag_norm_integ_;
+  mutable ESRBuffer<double> vydata_imag_; //!
+  mutable ESRBuffer<double> vydata_imag_integ_; //!
+  mutable ESRBuffer<double> vydata_imag_norm_; //!
+  mutable ESRBuffer<double> vydata_imag_norm_integ_; //!
+
+  // prefix tables of integral by channel, for Integrate() and partial integrals.
+  mutable ESRIntegralTable integ_table_[4]; //!
+
+  // baseline subtraction stage, on a channel (+ 4 if integral) of reduced data.
+  mutable ESRBaseline baseline_; //!
+  mutable int baseline_source_ = -1; //!
 
   /* original data. data to be processed further are "reduced" data.
      original one are stored and can be accessed.
+     Uniform x is kept as (x0, dx). Normalised data is not stored: y / gain_.
+     Raw binary file is not copied: channels refer the mapped file.
    */
-  std::vector<double> vxdata_orig_;
-  std::vector<double> vydata_orig_;
-  std::vector<double> vydata_norm_orig_;
-  std::vector<double> vydata_imag_orig_;
-  std::vector<double> vydata_imag_norm_orig_;
+  ESRAxis vxdata_orig_; //!
+  ESRChannel vydata_orig_; //!
+  ESRChannel vydata_imag_orig_; //!
+
+  // x step of samples appended without x (streaming)
+  double stream_dx_ = 1; //!
+
+  // memory mapped raw binary file (file type 3 only). not persistent.
+  std::shared_ptr<ESRRawFile> raw_file_; //!
+
+  /* reduction pyramid: products at power-of-two reduction factors (see BuildPyramid()).
+     Arrays and graphs are shared with the current products: switching costs O(1). */
+  struct Level
+  {
+    unsigned ready = 0;
+    ESRBuffer<double> x;
+    ESRBuffer<double> y[4]; // by channel (see Channel())
+    ESRBuffer<double> y_integ[4];
+    std::shared_ptr<TGraph> graph[4];
+    std::shared_ptr<TGraph> graph_integ[4];
+  };
+  std::map<int, Level> pyramid_; //!
 
   // stop nama-po
-  std::shared_ptr<TGraph> graph_;
-  std::shared_ptr<TGraph> graph_norm_;
-  std::shared_ptr<TGraph> graph_integ_;
-  std::shared_ptr<TGraph> graph_norm_integ_;
-  std::shared_ptr<TGraph> graph_imag_;
-  std::shared_ptr<TGraph> graph_imag_norm_;
-  std::shared_ptr<TGraph> graph_imag_integ_;
-  std::shared_ptr<TGraph> graph_imag_norm_integ_;
+  mutable std::shared_ptr<TGraph> graph_;
+  mutable std::shared_ptr<TGraph> graph_norm_;
+  mutable std::shared_ptr<TGraph> graph_integ_;
+  mutable std::shared_ptr<TGraph> graph_norm_integ_;
+  mutable std::shared_ptr<TGraph> graph_imag_;
+  mutable std::shared_ptr<TGraph> graph_imag_norm_;
+  mutable std::shared_ptr<TGraph> graph_imag_integ_;
+  mutable std::shared_ptr<TGraph> graph_imag_norm_integ_;
 
   // methods
   bool CheckInputFile(std::ifstream&);
@@ -117,16 +170,41 @@ protected:
   void MakeHeader(const std::map<std::string, std::string>&);
   void ParseData(std::ifstream&);
   void LoadFromROOTFile();
+  void LoadFromROOTTree(TTree*);
+  static std::string SerializeHeader(const std::map<std::string, std::string>&);
+  static std::map<std::string, std::string> DeserializeHeader(const std::string&);
+  bool LoadFromCache();
+  void WriteCache() const;
 
   void SetParams();
-  void ReduceData();
+  void AssignOrig(std::vector<double>&& y, std::vector<double>&& y_imag);
+  void Combine(double self_weight, const std::vector<const ESR*>& others, const std::vector<double>& weights);
+
+  // lazy products
+  static int Channel(bool is_norm, bool is_imag);
+  const ESRChannel& GetOrig(int channel) const;
+  ESRBuffer<double>& GetReduced(int channel) const;
+  ESRBuffer<double>& GetInteg(int channel) const;
+  std::shared_ptr<TGraph>& GetGraphRef(int channel, bool is_integ) const;
+  const ESRIntegralTable& GetIntegTable(int channel) const;
+  void Materialize(unsigned products) const;
+  void ResetProducts();
+  void ResetGraphs();
+  void StoreLevel();
+  bool LoadLevel();
+
+  const ESRDecimator& GetDecimator() const;
+  void ReduceData(int first_bin = 0, unsigned channels = 0xf) const;
 
   std::pair<std::vector<double>, std::vector<double> >
   DoIntegral(const std::vector<double>&, const std::vector<double>&, double, double,
              const std::pair<bool, double> integral_constant = {false, 0}) const;
-  void IntegrateData();
+  bool CheckIntegralRange(double& start, double& end) const;
+  void IntegrateData(unsigned channels = 0xf) const;
+  void IntegrateTail(std::size_t from);
 
-  void MakeAllGraphs();
+  void MakeAllGraphs(unsigned products = 0xff00) const;
+  void UpdateGraphs(std::size_t from);
   TGraph* MakeGraph(const std::vector<double>&, const std::vector<double>&) const;
   void MakeupGraph(const std::shared_ptr<TGraph>&,
                    const GraphStyle&, const std::string title = "") const;
@@ -134,13 +212,36 @@ protected:
 public:
   ESR();
   ESR(const std::string, const int reduction_factor = 1);
+  ESR(const std::map<std::string, std::string>&, int reduction_factor = 1); // streaming
   ESR& operator=(const ESR&); // copy operator=
   ESR(const ESR&); // copy constructor
   ESR& operator=(ESR&& esr) noexcept; // move operator=
   ESR(ESR&&) noexcept; // move constructor
   ~ESR();
 
+  /**
+     derived products. bit = kind x channel, so that kind & channel selects one:
+     e.g. ESR::kInteg & ESR::kReal is integral of raw real part.
+   */
+  enum Product : unsigned
+    {
+      kNone = 0,
+      // kind
+      kData = 0x000f, // reduced data
+      kInteg = 0x00f0, // integrated
+      kGraph = 0x0f00, // graph of reduced data
+      kGraphInteg = 0xf000, // graph of integrated
+      // channel
+      kReal = 0x1111,
+      kNorm = 0x2222,
+      kImag = 0x4444,
+      kImagNorm = 0x8888,
+      kAll = 0xffff
+    };
+
   // static member
+  static unsigned default_products; // = kNone. products calculated by constructor
+  static ESRDecimator::Mode default_reduction_mode; // = ESRDecimator::kBoxcar
   static std::string x_axis_title;// = "Magnetic field (mT)";
   static std::string y_axis_title;// = "Amplitude"
   static GraphStyle gs_sig;
@@ -148,22 +249,35 @@ public:
   static GraphStyle gs_sig_imag;
   static GraphStyle gs_sig_imag_integ;
   static std::string date_format; // "%Y/%m/%d %H:%M"   ~ is removed.
+  static bool use_cache; // = false. binary sidecar of text file (see ESRCache)
+  static int root_format_version; // = 2. layout written by Write()
+  static const int root_format_version_max = 2; // newest layout read by the constructor
+  static int root_compression; // = 505. TFile::SetCompressionSettings
+  static bool root_float_storage; // = false. store channels as float (version 2)
+  static bool float_storage; // = false. keep original channels as float in memory
+  static ESRResampler::Method arithmetic_interpolation; // = kLinear. other x axis in Add(), Average(), ...
 
   // --- methods ---
   /*  getter  */
   int GetFileType() const;
   std::shared_ptr<ESRHeader> GetHeader() const;
+  const std::map<std::string, std::string>& GetRawHeader() const;
   std::string GetFilePath() const;
   int GetDataLength() const;
   std::string GetDate() const;
   time_t GetDateAsUT() const; // muda-function
   double GetGain() const;
+  double GetFrequency() const; // MHz
+  int GetAccumulationCount() const;
 
   std::shared_ptr<TGraph> GetGraph(bool is_norm = false, bool is_imag = false) const;
   std::shared_ptr<TGraph> GetGraphInteg(bool is_norm = false, bool is_imag = false) const;
   std::shared_ptr<TGraph> GetGraphIntegPart(double, double,
                                             const std::pair<bool, double> integral_constant = {false, 0},
                                             bool is_norm = false, bool is_imag = false) const;
+  ESRIntegralTable::View GetYIntegPart(double, double,
+                                       const std::pair<bool, double> integral_constant = {false, 0},
+                                       bool is_norm = false, bool is_imag = false) const;
 
   std::pair<double, double> GetXrange() const; // just return header info
   std::pair<double, double> GetYrange() const; // just return header info
@@ -171,13 +285,55 @@ public:
   double GetXmax() const;
   std::vector<double> GetX() const;
   std::vector<double> GetY(bool is_norm = false, bool is_imag = false) const;
+  Span<double> GetXSpan() const;
+  Span<double> GetYSpan(bool is_norm = false, bool is_imag = false) const;
+  Span<double> GetYIntegSpan(bool is_norm = false, bool is_imag = false) const;
+  std::shared_ptr<ESRRawFile> GetRawFile() const;
+  Span<float> GetRawSpan(bool is_imag = false) const;
+  const ESRChannel& GetOrigChannel(bool is_imag = false) const;
+  const ESRAxis& GetOrigAxis() const;
 
   // setter
   void SetReductionFactor(int reduction_factor = 1);
+  void SetReductionMode(ESRDecimator::Mode mode);
+  ESRDecimator::Mode GetReductionMode() const;
+  void SetProducts(unsigned products);
+  unsigned GetProducts() const;
+  void BuildPyramid(int max_factor = 128);
+  void ClearPyramid();
+  void Denoise(ESRDenoiser::Mode mode, double width, bool is_orig = false);
+
+  // arithmetic of original data (blank subtraction, averaging of scans)
+  ESR& Add(const ESR& other, double weight = 1);
+  ESR& Subtract(const ESR& other, double weight = 1);
+  ESR& SubtractNormalized(const ESR& reference, double weight = 1);
+  ESR& Scale(double factor);
+  static ESR Average(const std::vector<const ESR*>& spectra, const std::vector<double>& weights = {});
+  ESR& operator+=(const ESR& other);
+  ESR& operator-=(const ESR& other);
+  ESR& operator*=(double factor);
+
+  // streaming
+  void Append(const std::vector<double>& y, const std::vector<double>& y_imag = {},
+              const std::vector<double>& x = {});
+  int Consume(ESRStream&);
 
   // function
   double Integrate(double, double, bool is_norm = false, bool is_imag = false,
                    const std::pair<bool, double> integral_constant = {false, 0}) const;
+  double GetDefiniteIntegral(double, double, bool is_norm = false, bool is_imag = false) const;
+
+  // baseline subtraction
+  ESRBaseline& GetBaselineStage(bool is_integ = true, bool is_norm = false, bool is_imag = false) const;
+  Span<double> SubtractPolynomialBaseline(const std::vector<std::pair<double, double> >& regions,
+                                          int order = 2, bool is_integ = true,
+                                          bool is_norm = false, bool is_imag = false) const;
+  Span<double> SubtractALSBaseline(double lambda = 1e5, double asymmetry = 0.01, int niter = 10,
+                                   bool is_integ = true, bool is_norm = false, bool is_imag = false) const;
+  std::shared_ptr<TGraph> GetGraphBaselineCorrected(double, double) const;
+
+  // lines, noise and windows of reduced (derivative) data
+  ESRFeatureDetector DetectFeatures(bool is_norm = false, bool is_imag = false) const;
   //   virtual void Write(const std::string output = "esr.root") const;
   virtual Int_t Write(const char* name=nullptr, Int_t option=0, Int_t bufsize=0) const final;
 
@@ -189,6 +345,11 @@ public:
   ClassDef(ESR, 1);
 };
 
+ESR operator+(const ESR&, const ESR&);
+ESR operator-(const ESR&, const ESR&);
+ESR operator*(const ESR&, double);
+ESR operator*(double, const ESR&);
+
 
 // // load namspace
 // #include "ESRUtil.hxx"
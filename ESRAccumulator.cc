@@ -0,0 +1,352 @@
+#include "ESRAccumulator.hh"
+
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+
+#include "TError.h"
+#include "TGraphErrors.h"
+
+#include "ESR.hh"
+#include "ESRHeader.hh"
+#include "ESRDecimator.hh"
+#include "ESRResampler.hh"
+
+double ESRAccumulator::clip = 4;
+int ESRAccumulator::min_scans = 3;
+double ESRAccumulator::max_reject_fraction = 0.05;
+double ESRAccumulator::max_chi2 = 4;
+
+ESRAccumulator::ESRAccumulator() :
+  nscans_(0), naccepted_(0), accumulation_count_(0)
+{}
+
+/** forget all scans. */
+void ESRAccumulator::Clear()
+{
+  *this = ESRAccumulator{};
+}
+
+/**
+   samples of part (0: real, 1: imaginary) of scan on the axis of the first scan,
+   into ys_[part] and is_valid_[part].
+   @return false if the part has no samples.
+ */
+bool ESRAccumulator::LoadScan(const ESR& scan, int part)
+{
+  auto n = axis_.GetSize();
+  auto& ys = ys_[part];
+  auto& is_valid = is_valid_[part];
+  const auto& ch = scan.GetOrigChannel(part == 1);
+  const auto& axis = scan.GetOrigAxis();
+  if(ch.GetSize() != axis.GetSize() or ch.IsEmpty())
+    return false;
+
+  ys.resize(n);
+  is_valid.assign(n, 1);
+  if(axis.IsSame(axis_))
+    {
+      ch.Visit([&](auto vals) {std::copy(vals, vals + n, ys.begin());});
+      return true;
+    }
+
+  if(xs_.empty())
+    xs_ = axis_.ToVector();
+  ESRResampler rs{xs_, ESRResampler::kField, ESR::arithmetic_interpolation};
+  auto table = rs.MakeTable(axis.ToVector());
+  ESRResampler::Apply(table, ch.ToVector(), ys.data());
+  for(std::size_t i = 0; i < n; ++i)
+    is_valid[i] = (table.first[i] != ESRResampler::npos);
+  return true;
+}
+
+/** mean of variances of points over points with two or more samples. */
+double ESRAccumulator::GetPooledVariance(int part) const
+{
+  const auto& m = clipped_[part];
+  double sum = 0;
+  std::size_t npoints = 0;
+  for(std::size_t i = 0; i < m.count.size(); ++i)
+    if(m.count[i] >= 2)
+      {
+        sum += m.m2[i] / (m.count[i] - 1);
+        ++npoints;
+      }
+  return (npoints > 0)? sum / npoints : 0.0;
+}
+
+/**
+   reject points of the loaded part beyond clip * sigma of the clipped mean.
+   @return false if the scan is bad.
+ */
+bool ESRAccumulator::Check(int part)
+{
+  const auto& m = clipped_[part];
+  const auto& ys = ys_[part];
+  const auto& is_valid = is_valid_[part];
+  auto& is_rejected = is_rejected_[part];
+  auto n = ys.size();
+  is_rejected.assign(n, 0);
+  if(naccepted_ < min_scans)
+    return true;
+
+  auto floor = 0.25 * GetPooledVariance(part); // (half of sigma)^2
+  auto clip2 = clip * clip;
+  double chi2 = 0;
+  std::size_t nvalid = 0, nrejected = 0;
+  for(std::size_t i = 0; i < n; ++i)
+    {
+      if(not is_valid[i] or m.count[i] == 0)
+        continue;
+      ++nvalid;
+      auto c = m.count[i];
+      auto var = (c >= 2)? m.m2[i] / (c - 1) : 0.0;
+      // spread of a new sample around the mean of c samples
+      auto s2 = std::max(var, floor) * (1 + 1.0 / c);
+      auto d = ys[i] - m.mean[i];
+      if(not (s2 > 0))
+        {
+          if(d != 0)
+            {
+              is_rejected[i] = 1;
+              ++nrejected;
+            }
+          continue;
+        }
+      auto r = d * d / s2;
+      if(r > clip2)
+        {
+          is_rejected[i] = 1;
+          ++nrejected;
+        }
+      else
+        chi2 += r;
+    }
+  if(nvalid == 0)
+    return true;
+
+  auto fraction = static_cast<double>(nrejected) / nvalid;
+  auto mean_chi2 = (nvalid > nrejected)? chi2 / (nvalid - nrejected) : 0.0;
+  if(fraction > max_reject_fraction or mean_chi2 > max_chi2)
+    {
+      Info("Check", "scan %d rejected: %.3g of points beyond clip, chi2 / point %.3g.",
+           nscans_ - 1, fraction, mean_chi2);
+      return false;
+    }
+  return true;
+}
+
+/** Welford update of valid and not rejected points. */
+void ESRAccumulator::Update(Moments& m, const std::vector<double>& ys,
+                            const std::vector<char>& is_valid, const std::vector<char>& is_rejected)
+{
+  auto n = ys.size();
+  for(std::size_t i = 0; i < n; ++i)
+    {
+      if(not is_valid[i] or (not is_rejected.empty() and is_rejected[i]))
+        continue;
+      auto c = ++m.count[i];
+      auto delta = ys[i] - m.mean[i];
+      m.mean[i] += delta / c;
+      m.m2[i] += delta * (ys[i] - m.mean[i]);
+    }
+}
+
+/**
+   add a scan. The first one defines x axis, header and gain of the output.
+   @return true if the scan is accepted in the clipped mean.
+ */
+bool ESRAccumulator::Add(const ESR& scan)
+{
+  if(not first_)
+    {
+      if(scan.GetOrigChannel().IsEmpty())
+        {
+          Warning("Add", "scan has no data. ignored.");
+          return false;
+        }
+      first_ = std::make_shared<ESR>(scan);
+      axis_ = scan.GetOrigAxis();
+      auto n = axis_.GetSize();
+      for(auto part = 0; part < 2; ++part)
+        for(auto m : {&all_[part], &clipped_[part]})
+          {
+            m->mean.assign(n, 0);
+            m->m2.assign(n, 0);
+            m->count.assign(n, 0);
+          }
+    }
+
+  bool has_part[2];
+  for(auto part = 0; part < 2; ++part)
+    {
+      has_part[part] = LoadScan(scan, part);
+      if(has_part[part])
+        Update(all_[part], ys_[part], is_valid_[part], {});
+    }
+  ++nscans_;
+  if(not has_part[0])
+    {
+      Warning("Add", "scan %d has no data. ignored.", nscans_ - 1);
+      return false;
+    }
+
+  for(auto part = 0; part < 2; ++part)
+    if(has_part[part] and not Check(part))
+      return false;
+
+  for(auto part = 0; part < 2; ++part)
+    if(has_part[part])
+      Update(clipped_[part], ys_[part], is_valid_[part], is_rejected_[part]);
+  ++naccepted_;
+  accumulation_count_ += std::max(1, scan.GetAccumulationCount());
+  return true;
+}
+
+/** add a scan read from a file. The scan is not kept. */
+bool ESRAccumulator::Add(const std::string& path)
+{
+  return Add(ESR{path});
+}
+
+int ESRAccumulator::GetNScans() const {return nscans_;}
+int ESRAccumulator::GetNAccepted() const {return naccepted_;}
+int ESRAccumulator::GetNRejected() const {return nscans_ - naccepted_;}
+
+/** number of points (of the first scan). */
+std::size_t ESRAccumulator::GetSize() const {return axis_.GetSize();}
+
+/**
+   running mean per point: of accepted points of accepted scans (is_clipped),
+   or of all scans.
+ */
+const std::vector<double>& ESRAccumulator::GetMean(bool is_imag, bool is_clipped) const
+{
+  return (is_clipped? clipped_ : all_)[is_imag? 1 : 0].mean;
+}
+
+/** unbiased variance of samples per point (0 with less than two samples). */
+std::vector<double> ESRAccumulator::GetVariance(bool is_imag, bool is_clipped) const
+{
+  const auto& m = (is_clipped? clipped_ : all_)[is_imag? 1 : 0];
+  std::vector<double> var(m.count.size(), 0);
+  for(std::size_t i = 0; i < var.size(); ++i)
+    if(m.count[i] >= 2)
+      var[i] = m.m2[i] / (m.count[i] - 1);
+  return var;
+}
+
+/** number of samples per point. */
+const std::vector<int>& ESRAccumulator::GetCount(bool is_imag, bool is_clipped) const
+{
+  return (is_clipped? clipped_ : all_)[is_imag? 1 : 0].count;
+}
+
+/** clipped mean. Points rejected in all scans have the mean of all scans. */
+std::vector<double> ESRAccumulator::GetClippedMean(bool is_imag) const
+{
+  auto part = is_imag? 1 : 0;
+  auto mean = clipped_[part].mean;
+  for(std::size_t i = 0; i < mean.size(); ++i)
+    if(clipped_[part].count[i] == 0)
+      mean[i] = all_[part].mean[i];
+  return mean;
+}
+
+/**
+   standard error of the clipped mean per point: sigma / sqrt(count).
+   Points with less than two samples use the mean variance over points.
+ */
+std::vector<double> ESRAccumulator::GetError(bool is_imag) const
+{
+  auto part = is_imag? 1 : 0;
+  const auto& m = clipped_[part];
+  auto pooled = GetPooledVariance(part);
+  std::vector<double> err(m.count.size());
+  for(std::size_t i = 0; i < err.size(); ++i)
+    {
+      auto c = m.count[i];
+      auto var = (c >= 2)? m.m2[i] / (c - 1) : pooled;
+      err[i] = std::sqrt(var / std::max(1, c));
+    }
+  return err;
+}
+
+/**
+   ESR of the clipped mean, with header, gain, and reduction of the first scan.
+   Accumulation count is the sum over accepted scans.
+ */
+ESR ESRAccumulator::GetESR() const
+{
+  if(not first_)
+    {
+      Error("GetESR", "no scan added.");
+      return ESR{};
+    }
+
+  ESR esr{*first_};
+  auto has_imag = (clipped_[1].count.size() == GetSize()
+                   and std::any_of(all_[1].count.cbegin(), all_[1].count.cend(), [](int c) {return c > 0;}));
+  esr.AssignOrig(GetClippedMean(false), has_imag? GetClippedMean(true) : std::vector<double>{});
+  if(esr.esr_header_)
+    esr.esr_header_->SetAccumulationCount(accumulation_count_);
+  return esr;
+}
+
+/**
+   graph of the clipped mean with standard errors (x errors are 0).
+   Points are averaged over groups of reduction_factor points (boxcar),
+   the last group over the points left as in ESR::ReduceData():
+   errors of the mean of a group are sqrt(sum of err^2) / points.
+   @param is_norm divided by the gain of the first scan
+ */
+std::shared_ptr<TGraphErrors> ESRAccumulator::GetGraphErrors(int reduction_factor, bool is_norm,
+                                                             bool is_imag) const
+{
+  if(not first_)
+    {
+      Error("GetGraphErrors", "no scan added.");
+      return nullptr;
+    }
+
+  auto r = static_cast<std::size_t>(std::max(1, reduction_factor));
+  auto n = GetSize();
+  auto ngroups = ESRDecimator::GetNbin(n, static_cast<int>(r));
+  if(ngroups == 0)
+    {
+      Warning("GetGraphErrors", "no points.");
+      return nullptr;
+    }
+
+  auto scale = (is_norm and first_->GetGain() != 0)? 1 / first_->GetGain() : 1.0;
+  auto mean = GetClippedMean(is_imag);
+  auto err = GetError(is_imag);
+  std::vector<double> gx(ngroups), gy(ngroups), gex(ngroups, 0), gey(ngroups);
+  for(std::size_t k = 0; k < ngroups; ++k)
+    {
+      auto last = std::min((k + 1) * r, n);
+      double points = last - k * r;
+      double sx = 0, sy = 0, se2 = 0;
+      for(auto i = k * r; i < last; ++i)
+        {
+          sx += axis_[i];
+          sy += mean[i];
+          se2 += err[i] * err[i];
+        }
+      gx[k] = sx / points;
+      gy[k] = scale * sy / points;
+      gey[k] = scale * std::sqrt(se2) / points;
+    }
+
+  return std::make_shared<TGraphErrors>(static_cast<int>(ngroups), gx.data(), gy.data(),
+                                        gex.data(), gey.data());
+}
+
+void ESRAccumulator::Print() const
+{
+  std::cout << "scans: " << nscans_ << std::endl
+            << "accepted: " << naccepted_ << std::endl
+            << "rejected: " << GetNRejected() << std::endl
+            << "points: " << GetSize() << std::endl
+            << "accumulation count: " << accumulation_count_ << std::endl;
+}
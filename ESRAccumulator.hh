@@ -0,0 +1,100 @@
+#ifndef ESRAccumulator_hh
+#define ESRAccumulator_hh
+
+#include <vector>
+#include <string>
+#include <memory>
+
+#include "ESRAxis.hh"
+
+class ESR;
+class TGraphErrors;
+
+/**
+   accumulation of scans stored separately, one scan at a time.
+
+   Memory is O(points): running mean and variance (Welford) of all scans,
+   and of accepted points of accepted scans (sigma clipped), per point,
+   for real and imaginary parts. Scans are not kept.
+
+   After min_scans scans are accepted, a new scan is compared with the
+   clipped mean: a point is rejected (spike) if it is beyond clip * sigma,
+   sigma is the spread of a point around the mean (at least half of the
+   mean sigma over points). A whole scan is rejected (bad scan) if too
+   many of its points are rejected, or its other points scatter more
+   than max_chi2 times the variance.
+
+   Scans on other x axes are interpolated onto the axis of the first one
+   (ESR::arithmetic_interpolation). Points out of range are not counted.
+
+   \code{.cpp}
+   ESRAccumulator acc;
+   for(const auto& path : paths)
+     acc.Add(path);
+   auto esr = acc.GetESR();                  // clipped mean as original data
+   auto g = acc.GetGraphErrors(128, true);   // with standard errors, e.g. for Fit()
+   \endcode
+ */
+class ESRAccumulator
+{
+public:
+  static double clip;                // = 4. points beyond clip * sigma are rejected
+  static int min_scans;              // = 3. scans accepted before rejection starts
+  static double max_reject_fraction; // = 0.05. scans with more rejected points are rejected
+  static double max_chi2;            // = 4. scans with larger mean (deviation / sigma)^2 are rejected
+
+private:
+  /* running moments per point. */
+  struct Moments
+  {
+    std::vector<double> mean;
+    std::vector<double> m2; // sum of squared deviations
+    std::vector<int> count;
+  };
+
+  std::shared_ptr<ESR> first_; // header and axis of output
+  ESRAxis axis_;
+  std::vector<double> xs_; // axis_ as array, made for interpolation
+  Moments all_[2];         // real, imaginary
+  Moments clipped_[2];
+  int nscans_;
+  int naccepted_;
+  int accumulation_count_; // sum over accepted scans
+
+  // work arrays of a scan
+  std::vector<double> ys_[2];
+  std::vector<char> is_valid_[2];
+  std::vector<char> is_rejected_[2];
+
+  bool LoadScan(const ESR& scan, int part);
+  bool Check(int part);
+  static void Update(Moments& m, const std::vector<double>& ys,
+                     const std::vector<char>& is_valid, const std::vector<char>& is_rejected);
+  double GetPooledVariance(int part) const;
+
+public:
+  ESRAccumulator();
+
+  bool Add(const ESR& scan);
+  bool Add(const std::string& path);
+  void Clear();
+
+  int GetNScans() const;
+  int GetNAccepted() const;
+  int GetNRejected() const;
+  std::size_t GetSize() const;
+
+  const std::vector<double>& GetMean(bool is_imag = false, bool is_clipped = true) const;
+  std::vector<double> GetVariance(bool is_imag = false, bool is_clipped = true) const;
+  const std::vector<int>& GetCount(bool is_imag = false, bool is_clipped = true) const;
+  std::vector<double> GetClippedMean(bool is_imag = false) const;
+  std::vector<double> GetError(bool is_imag = false) const;
+
+  ESR GetESR() const;
+  std::shared_ptr<TGraphErrors> GetGraphErrors(int reduction_factor = 1, bool is_norm = false,
+                                               bool is_imag = false) const;
+
+  void Print() const;
+};
+
+#endif
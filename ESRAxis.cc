@@ -0,0 +1,131 @@
+#include "ESRAxis.hh"
+
+ESRAxis::ESRAxis() :
+  vals_(), size_(0), x0_(0), dx_(0), is_uniform_(true)
+{}
+
+/**
+   x[i] = x0 + i * dx for i < size. No array is allocated.
+ */
+void ESRAxis::SetUniform(std::size_t size, double x0, double dx)
+{
+  vals_.Reset();
+  size_ = size;
+  x0_ = x0;
+  dx_ = dx;
+  is_uniform_ = true;
+}
+
+/**
+   set values. If they are exactly x0 + i * dx (as made by a sweep),
+   only x0 and dx are kept.
+ */
+void ESRAxis::Assign(std::vector<double>&& vals)
+{
+  size_ = vals.size();
+  if(size_ >= 2)
+    {
+      x0_ = vals[0];
+      dx_ = vals[1] - vals[0];
+      is_uniform_ = true;
+      for(auto i = 2ul; i < size_ and is_uniform_; ++i)
+        is_uniform_ = (vals[i] == x0_ + static_cast<double>(i) * dx_);
+    }
+  else
+    {
+      x0_ = size_? vals[0] : 0;
+      dx_ = 0;
+      is_uniform_ = true;
+    }
+
+  if(is_uniform_)
+    vals_.Reset();
+  else
+    vals_.Assign(std::move(vals));
+}
+
+/**
+   append explicit values. Uniform axis is expanded into an array.
+ */
+void ESRAxis::Append(const double* vals, std::size_t n)
+{
+  Expand();
+  auto& xs = vals_.Mutable();
+  xs.insert(xs.end(), vals, vals + n);
+  size_ = xs.size();
+}
+
+/**
+   append n points of x0 + i * dx, where i is the index in whole axis.
+   Uniform axis stays uniform if x0 and dx are the same as before.
+ */
+void ESRAxis::AppendUniform(std::size_t n, double x0, double dx)
+{
+  if(size_ == 0)
+    {
+      SetUniform(n, x0, dx);
+      return;
+    }
+
+  if(is_uniform_ and x0 == x0_ and dx == dx_)
+    {
+      size_ += n;
+      return;
+    }
+
+  Expand();
+  auto& xs = vals_.Mutable();
+  for(auto i = size_; i < size_ + n; ++i)
+    xs.push_back(x0 + static_cast<double>(i) * dx);
+  size_ = xs.size();
+}
+
+void ESRAxis::Clear() {SetUniform(0, 0, 0);}
+
+/**
+   switch to explicit values.
+ */
+void ESRAxis::Expand()
+{
+  if(not is_uniform_)
+    return;
+  vals_.Assign(ToVector());
+  is_uniform_ = false;
+}
+
+std::size_t ESRAxis::GetSize() const {return size_;}
+
+bool ESRAxis::IsEmpty() const {return size_ == 0;}
+
+bool ESRAxis::IsUniform() const {return is_uniform_;}
+
+double ESRAxis::GetX0() const {return x0_;}
+
+double ESRAxis::GetDx() const {return dx_;}
+
+/** true if both have the same points (uniform axes: same x0 and dx). */
+bool ESRAxis::IsSame(const ESRAxis& other) const
+{
+  if(size_ != other.size_)
+    return false;
+  if(is_uniform_ and other.is_uniform_)
+    return x0_ == other.x0_ and dx_ == other.dx_;
+  for(auto i = 0ul; i < size_; ++i)
+    if((*this)[i] != other[i])
+      return false;
+  return true;
+}
+
+/**
+   return a copy as array.
+ */
+std::vector<double> ESRAxis::ToVector() const
+{
+  if(not is_uniform_)
+    return vals_.Get();
+
+  std::vector<double> vals(size_);
+  for(auto i = 0ul; i < size_; ++i)
+    vals[i] = x0_ + static_cast<double>(i) * dx_;
+  return vals;
+}
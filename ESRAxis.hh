@@ -0,0 +1,60 @@
+#ifndef ESRAxis_hh
+#define ESRAxis_hh
+
+#include <vector>
+#include <cstddef>
+
+#include "ESRBuffer.hh"
+
+/**
+   x axis of original samples.
+
+   Text (normal format) and raw binary files have a uniform sweep,
+   x[i] = x0 + i * dx, which is kept as (x0, dx) without any array.
+   Otherwise (wave format, ROOT file, streaming with x) values are stored
+   in a buffer shared by copies (copy-on-write).
+
+   \code{.cpp}
+   ESRAxis x;
+   x.SetUniform(n, xmin, (xmax - xmin) / n);
+   auto xi = x[i]; // xmin + i * dx
+   \endcode
+ */
+class ESRAxis
+{
+  ESRBuffer<double> vals_; // empty if uniform
+  std::size_t size_;
+  double x0_;
+  double dx_;
+  bool is_uniform_;
+
+  void Expand();
+
+public:
+  ESRAxis();
+
+  void SetUniform(std::size_t size, double x0, double dx);
+  void Assign(std::vector<double>&& vals);
+  void Append(const double* vals, std::size_t n);
+  void AppendUniform(std::size_t n, double x0, double dx);
+  void Clear();
+
+  std::size_t GetSize() const;
+  bool IsEmpty() const;
+  bool IsUniform() const;
+  double GetX0() const;
+  double GetDx() const;
+  bool IsSame(const ESRAxis& other) const;
+
+  /** i-th x. Same value as the array made by x0 + i * dx. */
+  double operator[](std::size_t i) const
+  {
+    return is_uniform_? x0_ + static_cast<double>(i) * dx_ : vals_[i];
+  }
+  double front() const {return (*this)[0];}
+  double back() const {return (*this)[size_ - 1];}
+
+  std::vector<double> ToVector() const;
+};
+
+#endif
@@ -0,0 +1,306 @@
+#include "ESRBaseline.hh"
+#include "ESRIntegrator.hh"
+
+#include <cmath>
+#include <algorithm>
+
+#include "TError.h"
+
+int ESRBaseline::max_order = 8;
+
+ESRBaseline::ESRBaseline() :
+  xs_(), ys_(), center_(0), scale_(1), order_(-1)
+{}
+
+/**
+   @param xs x of points (ascending). shared, not copied.
+   @param ys y of points. shared, not copied.
+ */
+ESRBaseline::ESRBaseline(const ESRBuffer<double>& xs, const ESRBuffer<double>& ys) :
+  xs_(xs), ys_(ys), center_(0), scale_(1), order_(-1)
+{
+  if(xs_.GetSize() != ys_.GetSize())
+    Warning("ESRBaseline", "size of x and y inconsistent: %zu <-> %zu", xs_.GetSize(), ys_.GetSize());
+
+  const auto& x = xs_.Get();
+  if(GetSize() > 0)
+    {
+      center_ = 0.5 * (x.front() + x[GetSize() - 1]);
+      scale_ = 0.5 * (x[GetSize() - 1] - x.front());
+      if(scale_ == 0)
+        scale_ = 1;
+    }
+}
+
+std::size_t ESRBaseline::GetSize() const {return std::min(xs_.GetSize(), ys_.GetSize());}
+
+/**
+   points with start <= x <= end.
+   @return [first, last) indices.
+ */
+std::pair<std::size_t, std::size_t> ESRBaseline::FindRange(double start, double end) const
+{
+  const auto& x = xs_.Get();
+  auto n = GetSize();
+  std::size_t first = std::lower_bound(x.begin(), x.begin() + n, start) - x.begin();
+  std::size_t last = std::upper_bound(x.begin(), x.begin() + n, end) - x.begin();
+  return {first, std::max(first, last)};
+}
+
+/**
+   prefix sums of t^k (k <= 2 * order) and y t^k (k <= order).
+   Made again only when a higher order is requested.
+ */
+void ESRBaseline::MakeSums(int order)
+{
+  if(order <= order_)
+    return;
+
+  const auto& x = xs_.Get();
+  const auto& y = ys_.Get();
+  auto n = GetSize();
+
+  std::vector<double> tk(n, 1.0), ytk(n), ts(n);
+  for(std::size_t i = 0; i < n; ++i)
+    ts[i] = (x[i] - center_) / scale_;
+
+  sum_t_.assign(2 * order + 1, std::vector<double>(n + 1, 0));
+  sum_yt_.assign(order + 1, std::vector<double>(n + 1, 0));
+  for(auto k = 0; k <= 2 * order; ++k)
+    {
+      if(k > 0)
+        for(std::size_t i = 0; i < n; ++i)
+          tk[i] *= ts[i];
+
+      ESRIntegrator::PrefixSum(tk.data(), n, sum_t_[k].data() + 1);
+      if(k <= order)
+        {
+          for(std::size_t i = 0; i < n; ++i)
+            ytk[i] = y[i] * tk[i];
+          ESRIntegrator::PrefixSum(ytk.data(), n, sum_yt_[k].data() + 1);
+        }
+    }
+  order_ = order;
+}
+
+/**
+   fit polynomial to points in background regions (a < x < b for every {a, b}).
+
+   The normal equation is made of differences of prefix sums, and solved
+   by Cholesky decomposition.
+
+   @return coefficients in t = (x - center) / scale (see EvalPolynomial()).
+   Empty if points are too few.
+ */
+std::vector<double> ESRBaseline::FitPolynomial(const std::vector<std::pair<double, double> >& regions,
+                                               int order)
+{
+  if(order < 0 or order > max_order)
+    {
+      Warning("FitPolynomial", "order must be 0 to %d -> %d", max_order, std::max(0, std::min(order, max_order)));
+      order = std::max(0, std::min(order, max_order));
+    }
+  MakeSums(order);
+
+  const auto& x = xs_.Get();
+  auto n = GetSize();
+  std::size_t nterm = order + 1;
+  std::vector<double> a(nterm * nterm, 0), b(nterm, 0);
+  std::size_t npts = 0;
+  for(const auto& region : regions)
+    {
+      // a < x < b
+      std::size_t lo = std::upper_bound(x.begin(), x.begin() + n, region.first) - x.begin();
+      std::size_t hi = std::lower_bound(x.begin(), x.begin() + n, region.second) - x.begin();
+      if(hi <= lo)
+        continue;
+      npts += hi - lo;
+      for(std::size_t i = 0; i < nterm; ++i)
+        {
+          for(std::size_t j = 0; j < nterm; ++j)
+            a[i * nterm + j] += sum_t_[i + j][hi] - sum_t_[i + j][lo];
+          b[i] += sum_yt_[i][hi] - sum_yt_[i][lo];
+        }
+    }
+
+  if(npts < nterm)
+    {
+      Warning("FitPolynomial", "too few points (%zu) in background regions.", npts);
+      return {};
+    }
+
+  // Cholesky: a = L L^T, L in the lower triangle of a
+  for(std::size_t j = 0; j < nterm; ++j)
+    {
+      auto d = a[j * nterm + j];
+      for(std::size_t k = 0; k < j; ++k)
+        d -= a[j * nterm + k] * a[j * nterm + k];
+      if(d <= 0)
+        {
+          Warning("FitPolynomial", "normal equation is singular.");
+          return {};
+        }
+      a[j * nterm + j] = std::sqrt(d);
+      for(auto i = j + 1; i < nterm; ++i)
+        {
+          auto s = a[i * nterm + j];
+          for(std::size_t k = 0; k < j; ++k)
+            s -= a[i * nterm + k] * a[j * nterm + k];
+          a[i * nterm + j] = s / a[j * nterm + j];
+        }
+    }
+  for(std::size_t i = 0; i < nterm; ++i) // L z = b
+    {
+      for(std::size_t k = 0; k < i; ++k)
+        b[i] -= a[i * nterm + k] * b[k];
+      b[i] /= a[i * nterm + i];
+    }
+  for(auto i = nterm; i-- > 0;) // L^T c = z
+    {
+      for(auto k = i + 1; k < nterm; ++k)
+        b[i] -= a[k * nterm + i] * b[k];
+      b[i] /= a[i * nterm + i];
+    }
+  return b;
+}
+
+/** value of polynomial given by FitPolynomial() at x. */
+double ESRBaseline::EvalPolynomial(const std::vector<double>& coefs, double x) const
+{
+  auto t = (x - center_) / scale_;
+  auto val = 0.0;
+  for(auto i = coefs.size(); i-- > 0;)
+    val = val * t + coefs[i];
+  return val;
+}
+
+/** corrected = y - baseline. */
+void ESRBaseline::Correct()
+{
+  const auto& y = ys_.Get();
+  auto n = GetSize();
+  corrected_.resize(n);
+  for(std::size_t i = 0; i < n; ++i)
+    corrected_[i] = y[i] - baseline_[i];
+}
+
+/**
+   subtract polynomial from all points in one pass.
+   @return corrected signal. valid until the next subtraction.
+ */
+Span<double> ESRBaseline::SubtractPolynomial(const std::vector<double>& coefs)
+{
+  const auto& x = xs_.Get();
+  auto n = GetSize();
+  baseline_.resize(n);
+  for(std::size_t i = 0; i < n; ++i)
+    baseline_[i] = EvalPolynomial(coefs, x[i]);
+  Correct();
+  return GetCorrected();
+}
+
+/**
+   subtract automatic baseline by asymmetric least squares.
+
+   @param lambda smoothness. second difference is taken by index (not by x).
+   @param asymmetry weight of points above the baseline (e.g. 0.001 - 0.05).
+   @param niter maximum number of reweighting. stops when weights do not change.
+   @return corrected signal. valid until the next subtraction.
+ */
+Span<double> ESRBaseline::SubtractALS(double lambda, double asymmetry, int niter)
+{
+  const auto& y = ys_.Get();
+  auto n = GetSize();
+  baseline_.resize(n);
+  if(n < 3)
+    {
+      std::copy(y.begin(), y.begin() + n, baseline_.begin());
+      Correct();
+      return GetCorrected();
+    }
+
+  work_.resize(5 * n);
+  auto w = work_.data();
+  auto dd = w + n;   // D of LDL^T
+  auto l1 = dd + n;  // L[i + 1][i]
+  auto l2 = l1 + n;  // L[i + 2][i]
+  auto z = l2 + n;
+  std::fill(w, w + n, 1.0);
+
+  /* D^T D of second difference (rows (1, -2, 1) at r, r + 1, r + 2; r < n - 2):
+     band elements of row i. */
+  const std::size_t nrow = n - 2;
+  auto band0 = [&](std::size_t i)
+    {
+      return ((i < nrow)? 1.0 : 0.0) + ((i >= 1 and i - 1 < nrow)? 4.0 : 0.0) + ((i >= 2 and i - 2 < nrow)? 1.0 : 0.0);
+    };
+  auto band1 = [&](std::size_t i) // A[i][i + 1]
+    {
+      return ((i < nrow)? -2.0 : 0.0) + ((i >= 1 and i - 1 < nrow)? -2.0 : 0.0);
+    };
+
+  for(auto iter = 0; iter < niter; ++iter)
+    {
+      // LDL^T of W + lambda D^T D
+      for(std::size_t i = 0; i < n; ++i)
+        {
+          auto d = w[i] + lambda * band0(i);
+          if(i >= 1)
+            d -= l1[i - 1] * l1[i - 1] * dd[i - 1];
+          if(i >= 2)
+            d -= l2[i - 2] * l2[i - 2] * dd[i - 2];
+          dd[i] = d;
+
+          if(i + 1 < n)
+            {
+              auto e = lambda * band1(i);
+              if(i >= 1)
+                e -= l2[i - 1] * l1[i - 1] * dd[i - 1];
+              l1[i] = e / d;
+            }
+          if(i + 2 < n)
+            l2[i] = lambda / d; // A[i][i + 2] = lambda
+        }
+
+      // L D L^T z = W y
+      for(std::size_t i = 0; i < n; ++i)
+        {
+          auto v = w[i] * y[i];
+          if(i >= 1)
+            v -= l1[i - 1] * z[i - 1];
+          if(i >= 2)
+            v -= l2[i - 2] * z[i - 2];
+          z[i] = v;
+        }
+      for(std::size_t i = 0; i < n; ++i)
+        z[i] /= dd[i];
+      for(auto i = n; i-- > 0;)
+        {
+          auto v = z[i];
+          if(i + 1 < n)
+            v -= l1[i] * baseline_[i + 1];
+          if(i + 2 < n)
+            v -= l2[i] * baseline_[i + 2];
+          baseline_[i] = v;
+        }
+
+      // reweight
+      auto is_changed = false;
+      for(std::size_t i = 0; i < n; ++i)
+        {
+          auto wi = (y[i] > baseline_[i])? asymmetry : 1 - asymmetry;
+          is_changed = is_changed or (wi != w[i]);
+          w[i] = wi;
+        }
+      if(not is_changed)
+        break;
+    }
+
+  Correct();
+  return GetCorrected();
+}
+
+Span<double> ESRBaseline::GetX() const {return xs_.GetSpan().subspan(0, GetSize());}
+Span<double> ESRBaseline::GetY() const {return ys_.GetSpan().subspan(0, GetSize());}
+Span<double> ESRBaseline::GetBaseline() const {return Span<double>(baseline_);}
+Span<double> ESRBaseline::GetCorrected() const {return Span<double>(corrected_);}
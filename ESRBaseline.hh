@@ -0,0 +1,73 @@
+#ifndef ESRBaseline_hh
+#define ESRBaseline_hh
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+#include "Span.hh"
+#include "ESRBuffer.hh"
+
+/**
+   baseline (background) subtraction of a spectrum.
+
+   - polynomial: fitted to points in background regions (a < x < b) by the
+     normal equation. Sums of t^k and y t^k are prefix sums made once, so
+     that sums over any regions are differences: fitting costs O(regions),
+     not O(n). t = (x - center) / scale is in [-1, 1].
+   - asymmetric least squares (ALS, Eilers and Boelens):
+     minimise sum w (y - z)^2 + lambda sum (second difference of z)^2,
+     where w = asymmetry above the baseline and 1 - asymmetry below.
+     The pentadiagonal system is solved by banded LDL^T in O(n) per iteration.
+
+   Baseline and corrected signal (y - baseline) are written into buffers
+   kept in this object: no allocation after the first subtraction.
+
+   \code{.cpp}
+   ESRBaseline bl{xs, ys};
+   auto coefs = bl.FitPolynomial({{324.6, 326.0}, {331.6, 332.1}}, 2);
+   auto sig = bl.SubtractPolynomial(coefs); // Span<double>, valid until next subtraction
+   bl.SubtractALS(1e5, 0.01);               // automatic baseline
+   \endcode
+ */
+class ESRBaseline
+{
+  ESRBuffer<double> xs_;
+  ESRBuffer<double> ys_;
+  double center_;
+  double scale_;
+
+  // prefix sums: sum_t_[k][i] = t_0^k + ... + t_(i-1)^k, sum_yt_[k][i] likewise with y.
+  int order_;
+  std::vector<std::vector<double> > sum_t_;
+  std::vector<std::vector<double> > sum_yt_;
+
+  std::vector<double> baseline_;
+  std::vector<double> corrected_;
+  std::vector<double> work_; // ALS: weights and band of the system
+
+  void MakeSums(int order);
+  void Correct();
+
+public:
+  static int max_order; // = 8.
+
+  ESRBaseline();
+  ESRBaseline(const ESRBuffer<double>& xs, const ESRBuffer<double>& ys);
+
+  std::size_t GetSize() const;
+  std::pair<std::size_t, std::size_t> FindRange(double start, double end) const;
+
+  std::vector<double> FitPolynomial(const std::vector<std::pair<double, double> >& regions,
+                                    int order = 2);
+  double EvalPolynomial(const std::vector<double>& coefs, double x) const;
+  Span<double> SubtractPolynomial(const std::vector<double>& coefs);
+  Span<double> SubtractALS(double lambda = 1e5, double asymmetry = 0.01, int niter = 10);
+
+  Span<double> GetX() const;
+  Span<double> GetY() const;
+  Span<double> GetBaseline() const;
+  Span<double> GetCorrected() const;
+};
+
+#endif
@@ -0,0 +1,269 @@
+#include "ESRBinaryHeader.hh"
+#include "ESRHeader.hh"
+#include "ESRHeaderElement.hh"
+
+#include <fstream>
+#include <charconv>
+#include <cstring> // memcpy, memchr
+
+#include "TError.h"
+
+
+const std::size_t ESRBinaryHeader::header_size = 0x2100;
+
+/**
+   offset, length, and type of fields. Order must be the same as Id.
+ */
+const ESRBinaryHeader::Field ESRBinaryHeader::fields[kNFields] =
+  {
+    // data head
+    {"file name", 0x10, 0x40, kString, 0},
+    {"data length", 0x56, 4, kInt32, 0},
+    {"data sort", 0x60, 0x10, kString, 0},
+    {"x-range min", 0x70, 4, kFloat32, 0},
+    {"x-range", 0x74, 4, kFloat32, 0},
+    {"x unit", 0x78, 2, kString, 0},
+    {"x-view min", 0xb4, 4, kFloat32, 0},
+    {"x-view max", 0xb8, 4, kFloat32, 0},
+    {"y-view min", 0xbc, 4, kFloat32, 0},
+    {"y-view max", 0xc0, 4, kFloat32, 0},
+    // sweep
+    {"center field", 0x18fc, 0x10, kString, 0},
+    {"sweep width(fine)", 0x190c, 0x10, kString, 0},
+    {"sweep width(coar)", 0x191c, 0x10, kString, 0},
+    {"sweep time", 0x194c, 4, kString, 0},
+    {"sweep control", 0x197c, 0x10, kString, 0},
+    {"modulation freq.", 0x1a5c, 0x10, kString, 0},
+    {"mod. width(fine)", 0x1a6c, 0x10, kString, 0},
+    {"mod. width(coarse)", 0x1a7c, 0x10, kString, 0},
+    {"phase", 0x1a8c, 0x10, kString, 0},
+    {"receiver mode", 0x1a9c, 0x10, kString, 0},
+    {"phase (fine)", 0x1aac, 0x10, kString, 0},
+    {"amplitude(fine)", 0x1abc, 0x10, kString, 0},
+    {"amplitude(coarse)", 0x1acc, 0x10, kString, 0},
+    {"time constant", 0x1adc, 0x10, kString, 0},
+    {"zero", 0x1aec, 0x10, kString, 0},
+    {"receiver mode2", 0x1afb, 0x10, kString, 0},
+    {"phase2 (fine)", 0x1b0c, 0x10, kString, 0},
+    {"amplitude2(fine)", 0x1b1c, 0x10, kString, 0},
+    {"amplitude2(coars)", 0x1b2c, 0x10, kString, 0},
+    {"time constant2", 0x1b3c, 0x10, kString, 0},
+    // microwave (SHF at 0x1bec is not used)
+    {"micro frequency", 0x1bf4, 0x10, kString, 0},
+    {"micro freq. unit", 0x1c04, 0x08, kString, 0},
+    {"micro power", 0x1c0c, 0x10, kString, 0},
+    {"micro power unit", 0x1c1c, 0x08, kString, 0},
+    {"micro phase", 0x1c24, 0x10, kString, 0},
+    {"micro gunp", 0x1cb4, 0x08, kString, 0},
+    {"micro ref", 0x1cbc, 0x08, kString, 0},
+    {"micro 30db", 0x1cc4, 0x08, kString, 0},
+    // acquisition
+    {"vt type", 0x1eac, 0x10, kString, 0},
+    {"temperature", 0x1ebc, 0x10, kString, 2},
+    {"temperature unit", 0x1efc, 0x04, kString, 2},
+    {"date", 0x205c, 0x10, kString, 0},
+    {"accumulation mode", 0x20b8, 0x08, kString, 0},
+    {"baseline", 0x20c0, 0x08, kString, 0},
+    {"sampling mode", 0x20c8, 0x08, kString, 0},
+  };
+
+namespace
+{
+  /** same as ESRHeaderElement::mysubstr(val, pos) */
+  std::string_view substr(std::string_view val, std::size_t pos)
+  {
+    return (pos > val.size())? val : val.substr(pos);
+  }
+
+  /** same as ESRHeaderElement::mystod: leading blanks are skipped, 0 if not a number. */
+  template <typename T>
+  T to_number(std::string_view val)
+  {
+    auto p = val.data(), end = val.data() + val.size();
+    while(p < end and (*p == ' ' or *p == '\t'))
+      ++p;
+    if(p < end and *p == '+')
+      ++p;
+
+    T x = 0;
+    if(std::from_chars(p, end, x).ec != std::errc{})
+      return T{0};
+    return x;
+  }
+
+  /** shortest string read back to the same double. */
+  std::string to_string(double val)
+  {
+    char buf[32];
+    auto res = std::to_chars(buf, buf + sizeof(buf), val);
+    return std::string(buf, res.ptr);
+  }
+}
+
+/**
+   read header_size bytes from the head of the stream at once.
+ */
+ESRBinaryHeader::ESRBinaryHeader(std::istream& is) :
+  buf_(header_size, '\x00'), is_valid_(false)
+{
+  is.clear();
+  is.seekg(0);
+  is.read(&buf_[0], header_size);
+  is_valid_ = (static_cast<std::size_t>(is.gcount()) == header_size);
+  is.clear();
+
+  if(not is_valid_)
+    Warning("ESRBinaryHeader", "header is truncated.");
+}
+
+ESRBinaryHeader::ESRBinaryHeader(const std::string& path) :
+  buf_(header_size, '\x00'), is_valid_(false)
+{
+  std::ifstream ifs(path.c_str(), std::ifstream::binary);
+  if(ifs.fail())
+    {
+      Warning("ESRBinaryHeader", "cannot open %s", path.c_str());
+      return;
+    }
+  *this = ESRBinaryHeader(ifs);
+}
+
+bool ESRBinaryHeader::IsValid() const {return is_valid_;}
+
+/**
+   string field: characters up to the first null, without leading 'skip' characters.
+   The view refers this object.
+ */
+std::string_view ESRBinaryHeader::GetString(Id id) const
+{
+  const auto& f = fields[id];
+  auto p = buf_.data() + f.offset + f.skip;
+  std::size_t n = f.length - f.skip;
+  auto q = static_cast<const char*>(std::memchr(p, '\x00', n));
+  return std::string_view(p, q? q - p : n);
+}
+
+int ESRBinaryHeader::GetInt(Id id) const
+{
+  const auto& f = fields[id];
+  if(f.type == kFloat32)
+    return static_cast<int>(GetDouble(id));
+  if(f.type == kString)
+    return to_number<int>(GetString(id));
+
+  std::int32_t val;
+  std::memcpy(&val, buf_.data() + f.offset, sizeof(val));
+  return val;
+}
+
+double ESRBinaryHeader::GetDouble(Id id) const
+{
+  const auto& f = fields[id];
+  if(f.type == kInt32)
+    return GetInt(id);
+  if(f.type == kString)
+    return to_number<double>(GetString(id));
+
+  float val;
+  std::memcpy(&val, buf_.data() + f.offset, sizeof(val));
+  return val;
+}
+
+/**
+   make header objects from fields directly.
+   Values are the same as ESRHeader made from GetMap(): spectrometer
+   parameters drop two-character prefix (e.g. "cf" of "cf336.0") and so on.
+ */
+std::shared_ptr<ESRHeader> ESRBinaryHeader::MakeHeader() const
+{
+  auto str = [&](Id id) {return std::string(GetString(id));};
+  auto num = [&](Id id) {return to_number<double>(substr(GetString(id), 2));};
+
+  // data head
+  auto dh = std::make_shared<ESRHeaderDH>();
+  dh->file_name_ = str(kFileName);
+  dh->data_length_ = GetInt(kDataLength);
+  dh->data_sort_ = str(kDataSort);
+  dh->x_range_min_ = GetDouble(kXrangeMin);
+  dh->x_range_ = GetDouble(kXrange);
+  dh->x_unit_ = str(kXunit);
+  dh->x_view_ = {GetDouble(kXviewMin), GetDouble(kXviewMax)};
+  dh->y_view_ = {GetDouble(kYviewMin), GetDouble(kYviewMax)};
+  dh->type_ = "tyFA";
+
+  // general parameter
+  auto gp = std::make_shared<ESRHeaderGP>();
+  gp->date_ = str(kDate);
+
+  // spectrometer parameters
+  auto sp = std::make_shared<ESRHeaderSP>();
+  sp->rcv_mode_ = str(kReceiverMode);
+  sp->rcv_mode2_ = str(kReceiverMode2);
+  sp->center_field_ = num(kCenterField);
+
+  sp->SW_.control = std::string(substr(GetString(kSweepControl), 2));
+  sp->SW_.time = num(kSweepTime);
+  sp->SW_.width = {num(kSweepWidthFine), num(kSweepWidthCoarse)};
+  sp->SW_.mod_freq = num(kModFreq);
+  sp->SW_.phase = {num(kPhase), num(kPhaseFine)};
+  sp->SW_.phase2 = {num(kPhase2Fine), 0};
+  sp->SW_.mod_width = {num(kModWidthFine), num(kModWidthCoarse)};
+  sp->SW_.amp1 = {num(kAmpFine), num(kAmpCoarse)};
+  sp->SW_.amp2 = {num(kAmp2Fine), num(kAmp2Coarse)};
+  sp->SW_.tc1 = num(kTimeConstant);
+  sp->SW_.tc2 = num(kTimeConstant2);
+
+  sp->zero_ = to_number<int>(substr(GetString(kZero), 2));
+
+  sp->MW_.freq = num(kMicroFreq);
+  sp->MW_.freq_unit = std::string(substr(GetString(kMicroFreqUnit), 2));
+  sp->MW_.power = num(kMicroPower);
+  sp->MW_.pwr_unit = std::string(substr(GetString(kMicroPowerUnit), 2));
+  sp->MW_.phase = to_number<int>(substr(GetString(kMicroPhase), 2));
+  sp->MW_.is_30db = (substr(GetString(kMicro30db), 2) == "on");
+  sp->MW_.is_ref = (substr(GetString(kMicroRef), 2) == "on");
+  sp->MW_.is_gunp = (substr(GetString(kMicroGunp), 2) == "on");
+
+  auto temperature = GetString(kTemperature);
+  sp->TMPR_.vt_type = str(kVtType);
+  sp->TMPR_.temperature = (temperature.find("RT") != std::string_view::npos)?
+    20 : to_number<double>(temperature);
+  sp->TMPR_.tmpr_unit = str(kTemperatureUnit);
+
+  // acquisition parameters
+  auto ap = std::make_shared<ESRHeaderAP>();
+  ap->accumu_mode_ = str(kAccumulationMode);
+  ap->baseline_ = str(kBaseline);
+  ap->sampling_mode_ = str(kSamplingMode);
+
+  // esr data
+  auto dt = std::make_shared<ESRHeaderDT>();
+  dt->length_ = GetInt(kDataLength);
+
+  return std::make_shared<ESRHeader>(dh, gp, sp, ap, dt);
+}
+
+/**
+   key-value map of all fields, as text file header.
+   Numbers are written so that they are read back to the same value.
+ */
+std::map<std::string, std::string> ESRBinaryHeader::GetMap() const
+{
+  std::map<std::string, std::string> key_val;
+  for(auto i = 0; i < kNFields; ++i)
+    {
+      auto id = static_cast<Id>(i);
+      const auto& f = fields[i];
+      if(f.type == kString)
+        key_val[f.key] = std::string(GetString(id));
+      else if(f.type == kInt32)
+        key_val[f.key] = std::to_string(GetInt(id));
+      else
+        key_val[f.key] = to_string(GetDouble(id));
+    }
+
+  key_val["length"] = key_val["data length"];
+  key_val["type"] = "tyFA";
+
+  return key_val;
+}
@@ -0,0 +1,81 @@
+#ifndef ESRBinaryHeader_hh
+#define ESRBinaryHeader_hh
+
+#include <string>
+#include <string_view>
+#include <map>
+#include <memory>
+#include <istream>
+#include <cstdint>
+
+class ESRHeader;
+
+/**
+   header of raw binary file (file type 3), decoded by a table.
+
+   The first header_size bytes are read at once. Every field is described
+   by one row of a compile-time table (offset, length, type), and typed
+   header objects (ESRHeaderDH, GP, SP, AP, DT) are filled from the bytes
+   directly: no seek per field, and no string map in between.
+   The key-value map (same keys as text files) is made only by GetMap().
+
+   \code{.cpp}
+   ESRBinaryHeader bh{"data.bin"}; // header only scan
+   if(bh.IsValid())
+     auto n = bh.GetInt(ESRBinaryHeader::kDataLength);
+   auto header = bh.MakeHeader(); // std::shared_ptr<ESRHeader>
+   \endcode
+ */
+class ESRBinaryHeader
+{
+public:
+  enum Type : std::uint8_t {kString, kInt32, kFloat32};
+
+  /** index of field in the table */
+  enum Id
+    {
+      kFileName, kDataLength, kDataSort, kXrangeMin, kXrange, kXunit,
+      kXviewMin, kXviewMax, kYviewMin, kYviewMax,
+      kCenterField, kSweepWidthFine, kSweepWidthCoarse, kSweepTime, kSweepControl,
+      kModFreq, kModWidthFine, kModWidthCoarse, kPhase, kReceiverMode, kPhaseFine,
+      kAmpFine, kAmpCoarse, kTimeConstant, kZero,
+      kReceiverMode2, kPhase2Fine, kAmp2Fine, kAmp2Coarse, kTimeConstant2,
+      kMicroFreq, kMicroFreqUnit, kMicroPower, kMicroPowerUnit, kMicroPhase,
+      kMicroGunp, kMicroRef, kMicro30db,
+      kVtType, kTemperature, kTemperatureUnit, kDate,
+      kAccumulationMode, kBaseline, kSamplingMode,
+      kNFields
+    };
+
+  /** one row of the table */
+  struct Field
+  {
+    const char* key; // key in header map
+    std::uint16_t offset;
+    std::uint8_t length;
+    Type type;
+    std::uint8_t skip; // leading chars dropped (string only)
+  };
+
+  static const std::size_t header_size; // = 0x2100
+  static const Field fields[kNFields];
+
+private:
+  std::string buf_;
+  bool is_valid_;
+
+public:
+  ESRBinaryHeader(std::istream& is);
+  ESRBinaryHeader(const std::string& path);
+
+  bool IsValid() const;
+
+  std::string_view GetString(Id id) const;
+  int GetInt(Id id) const;
+  double GetDouble(Id id) const;
+
+  std::shared_ptr<ESRHeader> MakeHeader() const;
+  std::map<std::string, std::string> GetMap() const;
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef ESRBuffer_hh
+#define ESRBuffer_hh
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+#include "Span.hh"
+
+/**
+   reference counted array with copy-on-write.
+
+   Copying a buffer shares the array: O(1). The array is copied only when
+   Mutable() is called while it is shared, so that the other owners never
+   see the change.
+
+   \code{.cpp}
+   ESRBuffer<double> a{std::vector<double>(n)};
+   auto b = a;          // no copy of samples
+   b.Mutable()[0] = 1;  // b gets its own array here. a is unchanged.
+   \endcode
+
+   Reference counts are atomic, but one buffer object must not be
+   mutated and read by several threads at the same time (like std::vector).
+ */
+template <typename T>
+class ESRBuffer
+{
+  std::shared_ptr<std::vector<T> > data_;
+
+  static const std::vector<T>& Empty()
+  {
+    static const std::vector<T> empty;
+    return empty;
+  }
+
+public:
+  ESRBuffer() : data_(nullptr) {}
+  ESRBuffer(std::vector<T>&& vals) : data_(std::make_shared<std::vector<T> >(std::move(vals))) {}
+
+  /** read-only access. No copy. */
+  const std::vector<T>& Get() const {return data_? *data_ : Empty();}
+
+  /** writable access. The array is copied first if it is shared. */
+  std::vector<T>& Mutable()
+  {
+    if(not data_)
+      data_ = std::make_shared<std::vector<T> >();
+    else if(data_.use_count() > 1)
+      data_ = std::make_shared<std::vector<T> >(*data_);
+    return *data_;
+  }
+
+  /** replace the array. Other owners keep the old one. */
+  void Assign(std::vector<T>&& vals) {data_ = std::make_shared<std::vector<T> >(std::move(vals));}
+  void Reset() {data_.reset();}
+
+  bool IsShared() const {return data_ and data_.use_count() > 1;}
+  std::size_t GetSize() const {return Get().size();}
+  bool IsEmpty() const {return Get().empty();}
+  const T* GetData() const {return Get().data();}
+  Span<T> GetSpan() const {return Span<T>(Get());}
+
+  const T& operator[](std::size_t i) const {return (*data_)[i];}
+};
+
+#endif
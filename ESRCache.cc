@@ -0,0 +1,262 @@
+#include "ESRCache.hh"
+#include "MappedFile.hh"
+
+#include <fstream>
+#include <cstdio>  // rename, remove
+#include <cstring> // memcpy
+
+#include "TError.h"
+
+
+std::string ESRCache::suffix = ".esrcache";
+const std::uint32_t ESRCache::version = 1;
+
+namespace
+{
+  const char magic[8] = {'E', 'S', 'R', 'C', 'A', 'C', 'H', 'E'};
+
+  /** source file fingerprint */
+  struct Fingerprint
+  {
+    std::uint64_t size = 0;
+    std::int64_t mtime = 0;
+    std::uint64_t hash = 0;
+  };
+
+  bool fingerprint(const std::string& path, Fingerprint& fp)
+  {
+    MappedFile mf{path};
+    if(not mf.IsOpen())
+      return false;
+    fp.size = mf.GetSize();
+    fp.mtime = mf.GetModificationTime();
+    fp.hash = ESRCache::Hash(mf.GetData(), mf.GetSize());
+    return true;
+  }
+
+  /** bounds-checked reader of mapped memory */
+  struct Reader
+  {
+    const char* p;
+    const char* end;
+
+    bool read(void* dst, std::size_t n)
+    {
+      if(static_cast<std::size_t>(end - p) < n)
+        return false;
+      std::memcpy(dst, p, n);
+      p += n;
+      return true;
+    }
+
+    bool read(std::string& s)
+    {
+      std::uint32_t n = 0;
+      if(not read(&n, sizeof(n)) or static_cast<std::size_t>(end - p) < n)
+        return false;
+      s.assign(p, n);
+      p += n;
+      return true;
+    }
+
+    bool skip(std::size_t n)
+    {
+      if(static_cast<std::size_t>(end - p) < n)
+        return false;
+      p += n;
+      return true;
+    }
+  };
+
+  template <typename T>
+  void put(std::ofstream& ofs, const T& v)
+  {
+    ofs.write(reinterpret_cast<const char*>(&v), sizeof(T));
+  }
+
+  void put(std::ofstream& ofs, const std::string& s)
+  {
+    put(ofs, static_cast<std::uint32_t>(s.size()));
+    ofs.write(s.data(), s.size());
+  }
+}
+
+/**
+   open sidecar of source_path and validate it against the current source file.
+   IsValid() is false if the sidecar is missing, broken, or stale.
+ */
+ESRCache::ESRCache(const std::string& source_path) :
+  file_(nullptr), is_valid_(false), file_type_(-1), header_(), data_length_(0), data_(nullptr)
+{
+  auto cache_path = GetCachePath(source_path);
+  std::ifstream probe(cache_path.c_str());
+  if(probe.fail()) // no sidecar: quietly return
+    return;
+  probe.close();
+
+  file_ = std::make_shared<MappedFile>(cache_path);
+  if(not file_->IsOpen())
+    return;
+
+  Reader rd{file_->GetData(), file_->GetData() + file_->GetSize()};
+
+  char mg[8];
+  std::uint32_t ver = 0;
+  std::int32_t type = -1;
+  Fingerprint fp;
+  if(not (rd.read(mg, sizeof(mg)) and std::memcmp(mg, magic, sizeof(magic)) == 0
+          and rd.read(&ver, sizeof(ver)) and ver == version
+          and rd.read(&type, sizeof(type))
+          and rd.read(&fp.size, sizeof(fp.size))
+          and rd.read(&fp.mtime, sizeof(fp.mtime))
+          and rd.read(&fp.hash, sizeof(fp.hash))))
+    {
+      Warning("ESRCache::ESRCache", "%s is broken or old version.", cache_path.c_str());
+      return;
+    }
+
+  // stale?
+  Fingerprint src;
+  if(not fingerprint(source_path, src)
+     or src.size != fp.size or src.mtime != fp.mtime or src.hash != fp.hash)
+    {
+      Info("ESRCache::ESRCache", "%s is stale.", cache_path.c_str());
+      return;
+    }
+
+  std::uint32_t nkey = 0;
+  if(not rd.read(&nkey, sizeof(nkey)))
+    return;
+  for(auto i = 0u; i < nkey; ++i)
+    {
+      std::string key, val;
+      if(not (rd.read(key) and rd.read(val)))
+        return;
+      header_[key] = val;
+    }
+
+  std::uint64_t n = 0;
+  if(not rd.read(&n, sizeof(n)))
+    return;
+
+  // arrays are aligned to 8 bytes
+  auto offset = rd.p - file_->GetData();
+  if(not rd.skip((8 - offset % 8) % 8)
+     or n > static_cast<std::size_t>(rd.end - rd.p) / (3 * sizeof(double)))
+    {
+      Warning("ESRCache::ESRCache", "%s is truncated.", cache_path.c_str());
+      return;
+    }
+
+  file_type_ = type;
+  data_length_ = n;
+  data_ = reinterpret_cast<const double*>(rd.p);
+  is_valid_ = true;
+}
+
+bool ESRCache::IsValid() const {return is_valid_;}
+
+int ESRCache::GetFileType() const {return file_type_;}
+
+const std::map<std::string, std::string>& ESRCache::GetHeader() const {return header_;}
+
+std::size_t ESRCache::GetDataLength() const {return data_length_;}
+
+/**
+   views into the mapped sidecar. Valid during the life time of this object.
+ */
+Span<double> ESRCache::GetX() const {return Span<double>{data_, data_length_};}
+
+Span<double> ESRCache::GetY(bool is_imag) const
+{
+  return Span<double>{data_ + (is_imag? 2 : 1) * data_length_, data_length_};
+}
+
+std::string ESRCache::GetCachePath(const std::string& source_path)
+{
+  return source_path + suffix;
+}
+
+/**
+   64 bit FNV-1a like hash, 8 bytes at a time.
+ */
+std::uint64_t ESRCache::Hash(const char* data, std::size_t size)
+{
+  const std::uint64_t prime = 0x100000001b3ull;
+  std::uint64_t h = 0xcbf29ce484222325ull;
+
+  std::size_t i = 0;
+  for(; i + 8 <= size; i += 8)
+    {
+      std::uint64_t w;
+      std::memcpy(&w, data + i, 8);
+      h = (h ^ w) * prime;
+    }
+  for(; i < size; ++i)
+    h = (h ^ static_cast<unsigned char>(data[i])) * prime;
+
+  return h ^ size;
+}
+
+/**
+   write sidecar of source_path. It is written into a temporary file
+   and renamed, so that a reader never sees a half-written sidecar.
+
+   @return false if the source cannot be read or the sidecar cannot be written.
+ */
+bool ESRCache::Write(const std::string& source_path, int file_type,
+                     const std::map<std::string, std::string>& header,
+                     const std::vector<double>& x, const std::vector<double>& y,
+                     const std::vector<double>& y_imag)
+{
+  if(x.size() != y.size() or x.size() != y_imag.size())
+    {
+      Warning("ESRCache::Write", "data size inconsistent. cache is not written.");
+      return false;
+    }
+
+  Fingerprint fp;
+  if(not fingerprint(source_path, fp))
+    return false;
+
+  auto cache_path = GetCachePath(source_path);
+  auto tmp_path = cache_path + ".tmp";
+  std::ofstream ofs(tmp_path.c_str(), std::ofstream::binary);
+  if(ofs.fail())
+    {
+      Warning("ESRCache::Write", "cannot write %s", tmp_path.c_str());
+      return false;
+    }
+
+  ofs.write(magic, sizeof(magic));
+  put(ofs, version);
+  put(ofs, static_cast<std::int32_t>(file_type));
+  put(ofs, fp.size);
+  put(ofs, fp.mtime);
+  put(ofs, fp.hash);
+
+  put(ofs, static_cast<std::uint32_t>(header.size()));
+  for(auto& kv : header)
+    {
+      put(ofs, kv.first);
+      put(ofs, kv.second);
+    }
+
+  put(ofs, static_cast<std::uint64_t>(x.size()));
+  const char pad[8] = {};
+  ofs.write(pad, (8 - static_cast<std::size_t>(ofs.tellp()) % 8) % 8);
+
+  ofs.write(reinterpret_cast<const char*>(x.data()), x.size() * sizeof(double));
+  ofs.write(reinterpret_cast<const char*>(y.data()), y.size() * sizeof(double));
+  ofs.write(reinterpret_cast<const char*>(y_imag.data()), y_imag.size() * sizeof(double));
+  ofs.close();
+
+  if(ofs.fail() or std::rename(tmp_path.c_str(), cache_path.c_str()) != 0)
+    {
+      Warning("ESRCache::Write", "fail to write %s", cache_path.c_str());
+      std::remove(tmp_path.c_str());
+      return false;
+    }
+
+  return true;
+}
@@ -0,0 +1,60 @@
+#ifndef ESRCache_hh
+#define ESRCache_hh
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <cstdint>
+
+#include "Span.hh"
+
+class MappedFile;
+
+/**
+   binary sidecar cache of a text spectrum.
+
+   The sidecar (source path + suffix) holds the parsed header map and the
+   original x, Re(y) and Im(y) as double, together with the size, mtime and
+   a hash of the source file. Reading it back is just mapping the file and
+   validating the fingerprint, so that header and data parsing is skipped.
+
+   Layout (little endian, native double):
+   - magic "ESRCACHE", version (uint32), file type (int32)
+   - source size (uint64), source mtime (int64), source hash (uint64)
+   - number of header entries (uint32), then {key length, key, value length, value}
+   - data length (uint64), padding to 8 bytes, x[n], y[n], y_imag[n]
+
+   Used by ESR when ESR::use_cache is true.
+ */
+class ESRCache
+{
+  std::shared_ptr<MappedFile> file_;
+  bool is_valid_;
+  int file_type_;
+  std::map<std::string, std::string> header_;
+  std::size_t data_length_;
+  const double* data_;
+
+public:
+  static std::string suffix; // = ".esrcache"
+  static const std::uint32_t version;
+
+  ESRCache(const std::string& source_path);
+
+  bool IsValid() const;
+  int GetFileType() const;
+  const std::map<std::string, std::string>& GetHeader() const;
+  std::size_t GetDataLength() const;
+  Span<double> GetX() const;
+  Span<double> GetY(bool is_imag = false) const;
+
+  static std::string GetCachePath(const std::string& source_path);
+  static std::uint64_t Hash(const char* data, std::size_t size);
+  static bool Write(const std::string& source_path, int file_type,
+                    const std::map<std::string, std::string>& header,
+                    const std::vector<double>& x, const std::vector<double>& y,
+                    const std::vector<double>& y_imag);
+};
+
+#endif
@@ -0,0 +1,103 @@
+#include "ESRChannel.hh"
+
+#include <algorithm>
+
+ESRChannel::ESRChannel(bool is_float) :
+  dvals_(), fvals_(), view_(), owner_(nullptr), is_float_(is_float)
+{}
+
+/**
+   set samples. With is_float, they are stored as float and vals is released.
+ */
+void ESRChannel::Assign(std::vector<double>&& vals, bool is_float)
+{
+  view_ = Span<float>{};
+  owner_.reset();
+  is_float_ = is_float;
+  if(is_float_)
+    {
+      fvals_.Assign(std::vector<float>(vals.begin(), vals.end()));
+      dvals_.Reset();
+      vals = std::vector<double>{};
+    }
+  else
+    {
+      dvals_.Assign(std::move(vals));
+      fvals_.Reset();
+    }
+}
+
+/**
+   refer float samples owned by owner (no copy).
+ */
+void ESRChannel::Assign(Span<float> view, std::shared_ptr<const void> owner)
+{
+  dvals_.Reset();
+  fvals_.Reset();
+  view_ = view;
+  owner_ = std::move(owner);
+  is_float_ = true;
+}
+
+/**
+   append samples. A view is copied into own float array first,
+   and so is an array shared with other channels.
+ */
+void ESRChannel::Append(const double* vals, std::size_t n)
+{
+  Detach();
+  if(is_float_)
+    {
+      auto& fs = fvals_.Mutable();
+      fs.insert(fs.end(), vals, vals + n);
+    }
+  else
+    {
+      auto& ds = dvals_.Mutable();
+      ds.insert(ds.end(), vals, vals + n);
+    }
+}
+
+void ESRChannel::Clear() {Assign(std::vector<double>{}, is_float_);}
+
+/**
+   copy viewed samples into own array.
+ */
+void ESRChannel::Detach()
+{
+  if(not view_.data())
+    return;
+  fvals_.Assign(std::vector<float>(view_.begin(), view_.end()));
+  view_ = Span<float>{};
+  owner_.reset();
+}
+
+std::size_t ESRChannel::GetSize() const
+{
+  if(not is_float_)
+    return dvals_.GetSize();
+  return view_.data()? view_.size() : fvals_.GetSize();
+}
+
+bool ESRChannel::IsEmpty() const {return GetSize() == 0;}
+
+bool ESRChannel::IsFloat() const {return is_float_;}
+
+bool ESRChannel::IsView() const {return view_.data() != nullptr;}
+
+/**
+   return a copy as double array, divided by scale (e.g. gain for normalised values).
+ */
+std::vector<double> ESRChannel::ToVector(double scale) const
+{
+  std::vector<double> vals(GetSize());
+  Visit([&](auto ys)
+        {
+          if(scale == 1)
+            std::copy(ys, ys + vals.size(), vals.begin());
+          else
+            for(auto i = 0ul; i < vals.size(); ++i)
+              vals[i] = ys[i] / scale;
+        });
+  return vals;
+}
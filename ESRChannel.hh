@@ -0,0 +1,80 @@
+#ifndef ESRChannel_hh
+#define ESRChannel_hh
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+#include "Span.hh"
+#include "ESRBuffer.hh"
+
+/**
+   original samples of one channel (real or imaginary part).
+
+   Samples are held in one of three ways:
+   - double array (default)
+   - float array (float32 storage, see ESR::float_storage): half of memory.
+     Data of the spectrometer is float anyway.
+   - read-only float view of memory owned by others, e.g. memory mapped raw file.
+
+   Arrays are shared between copies (copy-on-write, see ESRBuffer):
+   copying a channel costs nothing until it is changed.
+
+   Normalised values are not stored: read them with a scale, e.g. Visit()
+   and divide by gain in the loop, or ToVector(gain).
+
+   \code{.cpp}
+   ch.Visit([&](auto ys) // const double* or const float*
+     {
+       for(auto i = 0ul; i < ch.GetSize(); ++i)
+         sum += ys[i];
+     });
+   \endcode
+ */
+class ESRChannel
+{
+  ESRBuffer<double> dvals_;
+  ESRBuffer<float> fvals_;
+  Span<float> view_;
+  std::shared_ptr<const void> owner_; // keeps memory of view_ alive
+  bool is_float_;
+
+  void Detach();
+
+public:
+  ESRChannel(bool is_float = false);
+
+  void Assign(std::vector<double>&& vals, bool is_float = false);
+  void Assign(Span<float> view, std::shared_ptr<const void> owner);
+  void Append(const double* vals, std::size_t n);
+  void Clear();
+
+  std::size_t GetSize() const;
+  bool IsEmpty() const;
+  bool IsFloat() const;
+  bool IsView() const;
+
+  double operator[](std::size_t i) const
+  {
+    return is_float_? static_cast<double>(view_.data()? view_[i] : fvals_[i]) : dvals_[i];
+  }
+
+  std::vector<double> ToVector(double scale = 1) const;
+
+  /**
+     call f with const pointer to samples: const double* or const float*.
+     f should be generic (template or auto parameter).
+   */
+  template <typename F>
+  void Visit(F&& f) const
+  {
+    if(not is_float_)
+      f(dvals_.GetData());
+    else if(view_.data())
+      f(view_.data());
+    else
+      f(fvals_.GetData());
+  }
+};
+
+#endif
@@ -1,4 +1,8 @@
 #include "ESRData.hh"
+#include "ESRIntegrator.hh"
+#include "ESR.hh"
+#include "ESRHeader.hh"
+#include "ESRResampler.hh"
 
 #include <iostream>
 #include <fstream>
@@ -11,10 +15,29 @@
 #include <TH1.h>
 #include <TF1.h>
 
-const std::string ESRData::commentTag_ = "=====";
-
 using namespace std;
 
+namespace {
+  
+  // sample i is at the center of bin i + 1 ( see iToG ): contents are set
+  // in bulk, with squares of weights as TH1::Fill( x, d ) made them.
+  template< typename T >
+  void setContents( TH1* h, const T* ys, int n, double amplitude ){
+    vector< double > contents( n + 2, 0.0 ), sumw2( n + 2, 0.0 );
+    for( int i = 0; i < n; i++ ){
+      float d = ys[ i ] / amplitude;
+      contents[ i + 1 ] = d;
+      sumw2[ i + 1 ] = static_cast< double >( d ) * d;
+    }
+    h->SetContent( contents.data() );
+    if( h->GetSumw2N() == 0 ) h->Sumw2();
+    h->GetSumw2()->Set( n + 2, sumw2.data() );
+    h->ResetStats();
+    h->SetEntries( n );
+  }
+  
+}
+
 ESRData::ESRData( ) : 
   name_( "" ), path_( "" ), 
   length_( 0 ), counter_( 0 ), dataType_( 0 ), dataKey_( "" ),
@@ -61,6 +84,18 @@ ESRData::ESRData( const std::string& path ) :
   this->load( path );
 }
 
+ESRData::ESRData( const ESR& esr ) : 
+  name_( "" ), path_( "" ), 
+  length_( 0 ), counter_( 0 ), dataType_( 0 ), dataKey_( "" ),
+  x_min_( 0.0 ), x_range_( 0.0 ), uwFreq_( 0.0 ), uwPower_( 0.0 ),
+  amplitude_fine_( 1.0 ), amplitude_coarse_( 1.0 ),
+  realPart_( NULL ), imagPart_( NULL ), integral_( NULL ), integral2_( NULL ),
+  real_mT_( NULL ), real_int_mT_( NULL ),
+  Mn_( 2, 0.0 )
+{
+  this->load( esr );
+}
+
 ESRData::~ESRData(){
   this->deleteObjs();
 }
@@ -114,135 +149,88 @@ ESRData& ESRData::operator=( const ESRData& data ){
   return *this;
 }
 
+// file is read by ESR: the same loader ( cache, memory map ) as the mT view.
 void ESRData::load( const string& path ){
   path_ = path;
   ifstream ifs( path_.c_str() );
   if( ifs ){
     cout << "Load " << path_ << endl;
-    this->load( ifs );
+    ifs.close();
+    this->load( ESR( path_ ) );
   } else {
     cerr << "Failed to open " << path_ << endl;
   }
 }
 
-void ESRData::load( std::istream& is ){
+// parameters from the header of esr, and samples shared with esr ( no copy, no parse ).
+void ESRData::load( const ESR& esr ){
   
-  string line;                                   // buffer line
-  dataType_ = 0;
-  dataKey_  = "";
-  counter_  = 0;
+  shared_ptr< ESRHeader > header = esr.GetHeader();
   
-  while( getline( is, line ) ){
-    
-    if( line.substr( 0, commentTag_.size() ) == commentTag_ ) continue;
-    
-    int pos = line.find( "= " );
-    if( pos != string::npos ){            // header information
-      this->parseDataLine( line.substr( 0, pos ),
-			   line.substr( pos + 2 ) );
-    } else if( dataType_ != 0 ) {         // ESR spectrum data part
-      float d = atof( line.c_str() ) / this->amplitude();
-      float x = this->iToG( counter_ );
-      if( dataType_ == 1 && realPart_ != NULL ) realPart_->Fill( x, d );
-      if( dataType_ == 1 && real_mT_ != NULL ) real_mT_->Fill( this->iToB( counter_ ), d );
-      if( dataType_ == 2 && imagPart_ != NULL ) imagPart_->Fill( x, d );
-      counter_++;
-    }
-  }
+  path_ = esr.GetFilePath();
+  name_ = header->GetDataHead()->GetFileName();
   
-  if( realPart_ != NULL )
-    integral2_ = this->integral( integral_ = this->integral( realPart_ ) );
+  pair< double, double > xrange = header->GetXrange();
+  x_min_   = xrange.first;
+  x_range_ = xrange.second - xrange.first;
   
-  if( real_mT_ != NULL ) real_int_mT_ = this->integral( real_mT_ );
+  uwFreq_ = esr.GetFrequency(); // MHz
+  auto mw = header->GetSpectrometerParameter()->GetMW();
+  uwPower_ = mw.power;
+  if( mw.pwr_unit == "W" )  uwPower_ /= 1000.0; // keep in mW
+  if( mw.pwr_unit == "uW" ) uwPower_ *= 1000.0; // keep in mW
   
-  for( int im = 0; im < 2; im++ ){
-    vector< double > area = this->markerArea( im + 1 );
-    Mn_[ im ] = this->markerSize( area[ 0 ], area[ 1 ] );
-  }
+  pair< double, double > amp = header->GetAmplitude( 1 );
+  amplitude_fine_   = amp.first;
+  amplitude_coarse_ = pow( 10.0, static_cast< int >( amp.second ) );
   
+  this->fill( esr.GetOrigChannel( false ), esr.GetOrigChannel( true ) );
 }
 
-void ESRData::parseDataLine( const std::string& tab, 
-			     const std::string& data ){
+// histograms from samples: real and imaginary part.
+// Header parameters ( x range, frequency, amplitude ) must be set before.
+void ESRData::fill( const ESRChannel& real, const ESRChannel& imag ){
   
-  if( tab == string( "length      " ) ){
-    length_   = atoi( data.c_str() );
-    dataKey_  = this->getDataKey();
-    
-    realPart_ = new TH1F( string( name_ + ":Re" ).c_str() , 
-			  string( name_ + " real part" ).c_str(),
-			  length_, this->xmin(), this->xmax() );
-
-    realPart_->GetXaxis()->SetTitle( "g-factor" );
-    
-    imagPart_ = new TH1F( string( name_ + ":Im" ).c_str(),
-			  string( name_ + " imaginary part" ).c_str(), 
-			  length_, this->xmin(), this->xmax() );
-    
-    real_mT_ = new TH1F( string( name_ + ":Re_mT" ).c_str() , 
-			 string( name_ + " real part [mT]" ).c_str(),
-			  length_, this->x_min_,
-			 this->x_min_ + this->x_range_ );
-    
-    return;
-  }
+  this->deleteObjs();
+  realPart_ = imagPart_ = integral_ = integral2_ = real_mT_ = real_int_mT_ = NULL;
   
-  if( tab == string( "file name   " ) ){
-    name_ = data.substr( 0, data.size() -1 ); // remove return code
-    return;
-  } 
+  length_  = real.GetSize();
+  counter_ = length_;
+  dataType_ = 2;
+  dataKey_ = this->getDataKey();
   
-  if( tab == string( "x-range min " ) ){
-    x_min_ = atof( data.c_str() );
-    return;
-  }
+  // axes are made once here: no conversion of x for each sample
+  realPart_ = new TH1F( string( name_ + ":Re" ).c_str() , 
+			string( name_ + " real part" ).c_str(),
+			length_, this->xmin(), this->xmax() );
   
-  if( tab == string( "x-range     " ) ){
-    x_range_ = atof( data.c_str() );
-    return;
-  }
+  realPart_->GetXaxis()->SetTitle( "g-factor" );
   
-  if( tab == string( "micro frequency   " ) ){
-    uwFreq_ = atof( data.substr( 2 ).c_str() );
-    return;
-  }
+  imagPart_ = new TH1F( string( name_ + ":Im" ).c_str(),
+			string( name_ + " imaginary part" ).c_str(), 
+			length_, this->xmin(), this->xmax() );
   
-  if( tab == string( "micro freq. unit  " ) ){
-    if( data.substr( 2 ) == "kHz" ) uwFreq_ /= 1000.0; // keep in MHz
-    if( data.substr( 2 ) == "GHz" ) uwFreq_ *= 1000.0; // keep in MHz
-    return;
-  }
+  real_mT_ = new TH1F( string( name_ + ":Re_mT" ).c_str() , 
+		       string( name_ + " real part [mT]" ).c_str(),
+		       length_, this->x_min_,
+		       this->x_min_ + this->x_range_ );
   
-  if( tab == string( "micro power       " ) ){
-    uwPower_ = atof( data.substr( 2 ).c_str() );
-    return;
-  }
+  double amp = this->amplitude();
+  real.Visit( [&]( auto ys ){
+      setContents( realPart_, ys, length_, amp );
+      setContents( real_mT_, ys, length_, amp );
+    } );
+  if( imag.GetSize() == real.GetSize() )
+    imag.Visit( [&]( auto ys ){ setContents( imagPart_, ys, length_, amp ); } );
   
-  if( tab == string( "micro power unit  " ) ){
-    if( data.substr( 2 ) == "W" )  uwPower_ /= 1000.0; // keep in mW
-    if( data.substr( 2 ) == "uW" ) uwPower_ *= 1000.0; // keep in mW
-    return;
-  }
+  this->integral( realPart_, integral_, integral2_ ); // both in one pass
+  real_int_mT_ = this->integral( real_mT_ );
   
-  if( tab == string( "amplitude(fine)   " ) ){
-    amplitude_fine_ = atof( data.substr( 2 ).c_str() );
-    return;
-  }
-
-  if( tab == string( "amplitude(coarse) " ) ){
-    amplitude_coarse_ = pow( 10.0, atoi( data.substr( 2 ).c_str() ) );
-    return;
+  for( int im = 0; im < 2; im++ ){
+    vector< double > area = this->markerArea( im + 1 );
+    Mn_[ im ] = this->markerSize( area[ 0 ], area[ 1 ] );
   }
-
   
-  if( dataKey_ != "" && 
-      tab.substr( 0, dataKey_.size() ) == dataKey_ ) { 
-    
-    if( data.substr( 0, 14 ) == string( "Real part data" ) ) dataType_ = 1;
-    if( data.substr( 0, 19 ) == string( "Imaginary part data" ) ) dataType_ = 2;
-    counter_ = 0;                                   // counter reset
-    return;
-  }
 }
 
 std::string ESRData::getDataKey() {
@@ -252,22 +240,37 @@ std::string ESRData::getDataKey() {
 }
 
 TH1* ESRData::integral( TH1* h1 ){
+  TH1 *first = NULL, *second = NULL;
+  this->integral( h1, first, second, false );
+  return first;
+}
 
-  if( h1 == NULL ) return NULL;
+// first and second integrals of h1 in one pass (ESRIntegrator).
+// Running sum from the underflow bin to bin N-1 with step dx();
+// bin N is set to 0 as before.
+void ESRData::integral( TH1* h1, TH1*& first, TH1*& second, bool withSecond ){
   
-  TH1 *copy = 
-    dynamic_cast< TH1* > ( h1->Clone( ( string( h1->GetName() ) + ":Int" ).c_str() ) );
+  first = second = NULL;
+  if( h1 == NULL ) return;
   
-  double weight = this->dx();
+  int nbins = h1->GetNbinsX();
+  vector< double > contents( nbins ), int1( nbins ), int2( withSecond ? nbins : 0 );
+  for( int bin = 0; bin < nbins; bin++ ) contents[ bin ] = h1->GetBinContent( bin );
   
-  for( int bin = 0; bin < copy->GetNbinsX(); bin++ ){
-    copy->SetBinContent( bin, 
-			 weight * copy->GetBinContent( bin ) + 
-			 ( bin == 0 ? 0.0 : copy->GetBinContent( bin - 1 ) ) ); 
-  }
-  copy->SetBinContent( copy->GetNbinsX(), 0.0 );
+  ESRIntegrator::Rectangle( this->dx(), contents.data(), nbins, int1.data(),
+			    withSecond ? int2.data() : NULL );
+  
+  first = 
+    dynamic_cast< TH1* > ( h1->Clone( ( string( h1->GetName() ) + ":Int" ).c_str() ) );
+  for( int bin = 0; bin < nbins; bin++ ) first->SetBinContent( bin, int1[ bin ] );
+  first->SetBinContent( nbins, 0.0 );
   
-  return copy;
+  if( ! withSecond ) return;
+  
+  second = 
+    dynamic_cast< TH1* > ( h1->Clone( ( string( h1->GetName() ) + ":Int:Int" ).c_str() ) );
+  for( int bin = 0; bin < nbins; bin++ ) second->SetBinContent( bin, int2[ bin ] );
+  second->SetBinContent( nbins, 0.0 );
 }
 
 double ESRData::iToG( const int& i ) const {
@@ -286,14 +289,7 @@ double ESRData::iToB( const int& i ) const {
 
 // B in mT
 double ESRData::bToG( const double& B ) const {
-  
-  const double mu_B = 5.7883818066E-11;         // MeV T^{-1}
-  const double hc   = 197.3269718 * 2.0 * M_PI; // MeV fm
-  const double c    = 2.99792458E+8;            // m s^{-1}
-  const double muB_c = mu_B * c;
-  const double A    =  hc * 1.0E-6 / muB_c;
-  
-  return ( A * uwFreq_ / B );   
+  return ESRResampler::FieldToG( B, uwFreq_ );
 }
 
 double ESRData::xmin() const {
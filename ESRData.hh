@@ -5,12 +5,15 @@
 #include <vector>
 
 class TH1;
+class ESR;
+class ESRChannel;
 
 class ESRData {
 public:
   
   ESRData( );                            // default constructor
   ESRData( const std::string& path );    // constructor with data file path
+  ESRData( const ESR& esr );             // constructor sharing samples of loaded ESR
   ESRData( const ESRData& data );        // a copy constructor
   virtual ~ESRData();                    // destructor
 
@@ -40,6 +43,8 @@ public:
   void uwPower( const double& v ) { uwPower_ = v; }
   
   void load( const std::string& path );
+  void load( const ESR& esr );
+  void fill( const ESRChannel& real, const ESRChannel& imag ); // samples as loaded by ESR
   
   static std::vector< double > markerArea( const int& i ); // get marker area ( 1 or 2 )
   
@@ -68,12 +73,9 @@ private:
   double amplitude_fine_;
   double amplitude_coarse_;
 
-  static const std::string commentTag_;
-  
-  void load( std::istream& is );
-  void parseDataLine( const std::string& key, const std::string& data );
   std::string getDataKey();
   TH1* integral( TH1* h1 );
+  void integral( TH1* h1, TH1*& first, TH1*& second, bool withSecond = true );
   
   void deleteObjs();
   
@@ -0,0 +1,279 @@
+#include "ESRDecimator.hh"
+
+#include <cmath>
+#include <algorithm>
+
+#include "TError.h"
+
+int ESRDecimator::fir_extent = 3;
+int ESRDecimator::sg_extent = 1;
+int ESRDecimator::sg_order = 4;
+
+namespace
+{
+  /**
+     sum of w[i] * y[i].
+     Four independent partial sums: no dependency between iterations,
+     so that the loop is vectorized by compiler (SSE2/AVX) without -ffast-math.
+   */
+  template <typename T>
+  double dot(const double* w, const T* y, std::size_t n)
+  {
+    double acc[4] = {0, 0, 0, 0};
+    std::size_t i = 0;
+    for(; i + 4 <= n; i += 4)
+      for(auto l = 0; l < 4; ++l)
+        acc[l] += w[i + l] * y[i + l];
+    for(; i < n; ++i)
+      acc[0] += w[i] * y[i];
+    return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+  }
+
+  /** solve a x = b (n x n, row major) by Gaussian elimination with partial pivoting. */
+  std::vector<double> solve(std::vector<double> a, std::vector<double> b)
+  {
+    auto n = b.size();
+    for(std::size_t col = 0; col < n; ++col)
+      {
+        auto pivot = col;
+        for(auto row = col + 1; row < n; ++row)
+          if(std::fabs(a[row * n + col]) > std::fabs(a[pivot * n + col]))
+            pivot = row;
+        if(pivot != col)
+          {
+            for(std::size_t k = 0; k < n; ++k)
+              std::swap(a[col * n + k], a[pivot * n + k]);
+            std::swap(b[col], b[pivot]);
+          }
+        for(auto row = col + 1; row < n; ++row)
+          {
+            auto f = a[row * n + col] / a[col * n + col];
+            for(auto k = col; k < n; ++k)
+              a[row * n + k] -= f * a[col * n + k];
+            b[row] -= f * b[col];
+          }
+      }
+    for(auto row = n; row-- > 0;)
+      {
+        for(auto k = row + 1; k < n; ++k)
+          b[row] -= a[row * n + k] * b[k];
+        b[row] /= a[row * n + row];
+      }
+    return b;
+  }
+}
+
+/**
+   @param factor reduction factor (number of points in a group).
+   @param mode kind of reduction. Weights are calculated here once.
+ */
+ESRDecimator::ESRDecimator(int factor, Mode mode) :
+  factor_(factor), mode_(mode), extent_(0), weights_(), edge_weights_()
+{
+  if(factor_ <= 0)
+    {
+      Warning("ESRDecimator", "factor must be greater than 0 -> 1");
+      factor_ = 1;
+    }
+
+  if(mode_ == kFIR)
+    {
+      extent_ = std::max(fir_extent, 0) * factor_;
+
+      /* windowed sinc centred at the group centre c.
+         cut-off is Nyquist frequency of reduced data: 0.5 / factor (cycles / point). */
+      auto n = factor_ + 2 * extent_;
+      auto c = 0.5 * (factor_ - 1);
+      auto fc = 0.5 / factor_;
+      weights_.resize(n);
+      for(auto j = 0; j < n; ++j)
+        {
+          auto t = j - extent_ - c;
+          auto sinc = (t == 0)? 2 * fc : std::sin(2 * M_PI * fc * t) / (M_PI * t);
+          auto phase = (n > 1)? 2 * M_PI * j / (n - 1) : 0;
+          auto window = 0.42 - 0.5 * std::cos(phase) + 0.08 * std::cos(2 * phase);
+          weights_[j] = sinc * window;
+        }
+      auto sum = 0.0;
+      for(auto w : weights_)
+        sum += w;
+      for(auto& w : weights_)
+        w /= sum;
+    }
+  else if(mode_ == kSavitzkyGolay)
+    {
+      extent_ = std::max(sg_extent, 0) * factor_;
+      weights_ = MakeWeights(-extent_, factor_ - 1 + extent_);
+    }
+  else
+    {
+      mode_ = kBoxcar;
+      weights_.assign(factor_, 1.0 / factor_);
+    }
+}
+
+int ESRDecimator::GetFactor() const {return factor_;}
+ESRDecimator::Mode ESRDecimator::GetMode() const {return mode_;}
+
+/** number of points used at each side of a group, in addition to the group. */
+int ESRDecimator::GetExtent() const {return extent_;}
+
+/** weights of points from -GetExtent() to GetFactor() - 1 + GetExtent(), relative to the group head. */
+const std::vector<double>& ESRDecimator::GetWeights() const {return weights_;}
+
+/** number of reduced points. The last group may be partial. */
+std::size_t ESRDecimator::GetNbin(std::size_t n, int factor)
+{
+  return (n + factor - 1) / factor;
+}
+
+/**
+   weights for points from lo to hi (relative to the group head),
+   which is a part of the full window at both ends of data.
+
+   FIR: full weights are cut and renormalised.
+   Savitzky-Golay: polynomial of order sg_order (less if points are few)
+   fitted to the points, evaluated at the group centre.
+ */
+std::vector<double> ESRDecimator::MakeWeights(int lo, int hi) const
+{
+  std::vector<double> ws;
+  if(mode_ == kFIR)
+    {
+      ws.assign(weights_.begin() + (lo + extent_), weights_.begin() + (hi + extent_ + 1));
+      auto sum = 0.0;
+      for(auto w : ws)
+        sum += w;
+      for(auto& w : ws)
+        w /= sum;
+      return ws;
+    }
+
+  // Savitzky-Golay. t is scaled to [-1, 1] for the normal equation.
+  auto npts = hi - lo + 1;
+  auto c = 0.5 * (factor_ - 1);
+  auto scale = std::max(0.5 * factor_ + extent_, 1.0);
+  std::size_t nterm = std::max(std::min(sg_order, npts - 1), 0) + 1;
+
+  std::vector<double> ts(npts);
+  for(auto k = 0; k < npts; ++k)
+    ts[k] = (lo + k - c) / scale;
+
+  // normal matrix: sum of t^(i+j)
+  std::vector<double> a(nterm * nterm, 0);
+  for(auto t : ts)
+    {
+      auto ti = 1.0;
+      for(std::size_t i = 0; i < nterm; ++i, ti *= t)
+        {
+          auto tij = ti;
+          for(std::size_t j = 0; j < nterm; ++j, tij *= t)
+            a[i * nterm + j] += tij;
+        }
+    }
+
+  // value at t = 0 is the constant term: weights are rows of A (A^T A)^-1 e0.
+  std::vector<double> e0(nterm, 0);
+  e0[0] = 1;
+  auto coef = solve(a, e0);
+
+  ws.resize(npts);
+  for(auto k = 0; k < npts; ++k)
+    {
+      auto w = 0.0, tj = 1.0;
+      for(std::size_t j = 0; j < nterm; ++j, tj *= ts[k])
+        w += coef[j] * tj;
+      ws[k] = w;
+    }
+  return ws;
+}
+
+/**
+   MakeWeights(lo, hi), made once per (lo, hi) and kept.
+   They depend only on (lo, hi): Savitzky-Golay is not refitted on every Decimate().
+ */
+const std::vector<double>& ESRDecimator::GetEdgeWeights(int lo, int hi) const
+{
+  auto key = std::make_pair(lo, hi);
+  auto it = edge_weights_.find(key);
+  if(it == edge_weights_.end())
+    it = edge_weights_.emplace(key, MakeWeights(lo, hi)).first;
+  return it->second;
+}
+
+/**
+   one pass over the bins from first_bin: every bin of all channels is made
+   before going to the next one.
+
+   Boxcar is the plain sum of the group in order: the same result as the
+   former implementation of ESR::ReduceData.
+ */
+template <typename T>
+void ESRDecimator::Run(std::size_t n, const std::vector<const T*>& ins,
+                       const std::vector<double>& divisors, const std::vector<double*>& outs,
+                       std::size_t first_bin) const
+{
+  const std::size_t factor = factor_, extent = extent_, nch = ins.size();
+  auto nbin = GetNbin(n, factor_);
+
+  for(auto ibin = first_bin; ibin < nbin; ++ibin)
+    {
+      auto begin = ibin * factor;
+      auto end = std::min(begin + factor, n);
+
+      if(mode_ == kBoxcar or end - begin < factor)
+        {
+          // last partial group is boxcar: its centre is the reduced x.
+          for(std::size_t ich = 0; ich < nch; ++ich)
+            {
+              auto ys = ins[ich];
+              auto div = divisors[ich];
+              auto sum = 0.0;
+              if(div == 1)
+                for(auto i = begin; i < end; ++i)
+                  sum += static_cast<double>(ys[i]);
+              else
+                for(auto i = begin; i < end; ++i)
+                  sum += ys[i] / div;
+              outs[ich][ibin] = sum / static_cast<double>(end - begin);
+            }
+        }
+      else if(begin >= extent and end + extent <= n)
+        {
+          // whole window inside data: no bounds check.
+          for(std::size_t ich = 0; ich < nch; ++ich)
+            outs[ich][ibin] = dot(weights_.data(), ins[ich] + (begin - extent), weights_.size()) / divisors[ich];
+        }
+      else
+        {
+          // at both ends: window is cut.
+          auto lo = -static_cast<int>(std::min(begin, extent));
+          auto hi = static_cast<int>(std::min(end + extent, n) - begin) - 1;
+          const auto& ws = GetEdgeWeights(lo, hi);
+          for(std::size_t ich = 0; ich < nch; ++ich)
+            outs[ich][ibin] = dot(ws.data(), ins[ich] + (begin + lo), ws.size()) / divisors[ich];
+        }
+    }
+}
+
+/**
+   reduce n points of every input into bins from first_bin.
+   Bins before first_bin are not touched: only new bins are made in streaming.
+
+   @param ins input arrays (n points each).
+   @param divisors every input is divided by this (e.g. gain for normalised data).
+   @param outs output arrays (GetNbin(n, factor) points each).
+ */
+void ESRDecimator::Decimate(std::size_t n, const std::vector<const double*>& ins,
+                            const std::vector<double>& divisors, const std::vector<double*>& outs,
+                            std::size_t first_bin) const
+{
+  Run(n, ins, divisors, outs, first_bin);
+}
+
+void ESRDecimator::Decimate(std::size_t n, const std::vector<const float*>& ins,
+                            const std::vector<double>& divisors, const std::vector<double*>& outs,
+                            std::size_t first_bin) const
+{
+  Run(n, ins, divisors, outs, first_bin);
+}
@@ -0,0 +1,75 @@
+#ifndef ESRDecimator_hh
+#define ESRDecimator_hh
+
+#include <vector>
+#include <map>
+#include <utility>
+#include <cstddef>
+
+/**
+   decimation (data reduction) of spectra by an integer factor.
+
+   Three kinds of reduction are available:
+   - kBoxcar: mean of every 'factor' points (default, same as before).
+   - kFIR: windowed-sinc low-pass (Blackman window, cut-off at Nyquist
+     frequency of the reduced data) evaluated at the centre of every group.
+     Aliasing of noise and distortion of narrow lines are much smaller than boxcar.
+   - kSavitzkyGolay: local polynomial fit (order sg_order) over the group and
+     neighbouring points, evaluated at the centre of the group.
+
+   Output bin b is at the centre of points [b * factor, (b + 1) * factor),
+   so that x of reduced data is the boxcar mean of x for any kind.
+   At both ends, weights are renormalised (FIR) or refitted (Savitzky-Golay)
+   over points available; the last partial group is a boxcar mean.
+
+   All channels are reduced in one pass over the bins.
+
+   \code{.cpp}
+   ESRDecimator dec{128, ESRDecimator::kFIR};
+   std::vector<const double*> ins{re.data(), im.data()};
+   dec.Decimate(n, ins, {1, gain}, {re_red.data(), im_red.data()});
+   \endcode
+ */
+class ESRDecimator
+{
+public:
+  enum Mode {kBoxcar, kFIR, kSavitzkyGolay};
+
+  static int fir_extent; // = 3. FIR window extends this many groups at each side.
+  static int sg_extent; // = 1. same for Savitzky-Golay
+  static int sg_order; // = 4. order of polynomial of Savitzky-Golay
+
+private:
+  int factor_;
+  Mode mode_;
+  int extent_; // points added at each side of a group
+  std::vector<double> weights_; // for offsets -extent_ ... factor_ - 1 + extent_
+  // windows cut at both ends of data, by (lo, hi). made on the first use.
+  mutable std::map<std::pair<int, int>, std::vector<double> > edge_weights_;
+
+  std::vector<double> MakeWeights(int lo, int hi) const;
+  const std::vector<double>& GetEdgeWeights(int lo, int hi) const;
+
+  template <typename T>
+  void Run(std::size_t n, const std::vector<const T*>& ins, const std::vector<double>& divisors,
+           const std::vector<double*>& outs, std::size_t first_bin) const;
+
+public:
+  ESRDecimator(int factor, Mode mode = kBoxcar);
+
+  int GetFactor() const;
+  Mode GetMode() const;
+  int GetExtent() const;
+  const std::vector<double>& GetWeights() const;
+
+  static std::size_t GetNbin(std::size_t n, int factor);
+
+  void Decimate(std::size_t n, const std::vector<const double*>& ins,
+                const std::vector<double>& divisors, const std::vector<double*>& outs,
+                std::size_t first_bin = 0) const;
+  void Decimate(std::size_t n, const std::vector<const float*>& ins,
+                const std::vector<double>& divisors, const std::vector<double*>& outs,
+                std::size_t first_bin = 0) const;
+};
+
+#endif
@@ -0,0 +1,233 @@
+#include "ESRDenoiser.hh"
+
+#include <cmath>
+#include <algorithm>
+
+#include "TError.h"
+
+int ESRDenoiser::wavelet_levels = 8;
+
+namespace
+{
+  // Daubechies-4: low-pass h, high-pass g = (h3, -h2, h1, -h0)
+  const double sqrt3 = std::sqrt(3.0);
+  const double norm = 4 * std::sqrt(2.0);
+  const double h[4] = {(1 + sqrt3) / norm, (3 + sqrt3) / norm, (3 - sqrt3) / norm, (1 - sqrt3) / norm};
+  const double g[4] = {h[3], -h[2], h[1], -h[0]};
+
+  /* one level of periodic transform of x (length len): approximation to
+     tmp[0, len / 2), detail to tmp[len / 2, len). */
+  void forward_step(const double* x, std::size_t len, double* tmp)
+  {
+    auto half = len / 2;
+    for(std::size_t i = 0; i < half; ++i)
+      {
+        double a = 0, d = 0;
+        for(auto k = 0; k < 4; ++k)
+          {
+            auto v = x[(2 * i + k) % len];
+            a += h[k] * v;
+            d += g[k] * v;
+          }
+        tmp[i] = a;
+        tmp[half + i] = d;
+      }
+  }
+
+  /* inverse of forward_step: transpose (orthogonal). */
+  void inverse_step(const double* tmp, std::size_t len, double* x)
+  {
+    auto half = len / 2;
+    std::fill(x, x + len, 0.0);
+    for(std::size_t i = 0; i < half; ++i)
+      for(auto k = 0; k < 4; ++k)
+        x[(2 * i + k) % len] += h[k] * tmp[i] + g[k] * tmp[half + i];
+  }
+}
+
+/**
+   @param mode kGaussian, kLorentzian or kWavelet
+   @param width sigma (kGaussian) or HWHM (kLorentzian) in unit of x,
+   or threshold in unit of the universal threshold (kWavelet). Nothing is done if width <= 0.
+ */
+ESRDenoiser::ESRDenoiser(Mode mode, double width) :
+  mode_(mode), width_(width)
+{}
+
+ESRDenoiser::Mode ESRDenoiser::GetMode() const {return mode_;}
+double ESRDenoiser::GetWidth() const {return width_;}
+
+/** power of two, at least 2 n: size of mirror extended spectrum. */
+std::size_t ESRDenoiser::GetExtendedSize(std::size_t n)
+{
+  std::size_t m = 1;
+  while(m < 2 * n)
+    m <<= 1;
+  return m;
+}
+
+/**
+   ys extended to m points by mirror images of both ends (periodic with m).
+   Both images meet in the middle of the extension.
+ */
+void ESRDenoiser::Extend(const double* ys, std::size_t n, std::size_t m, double* out) const
+{
+  std::copy(ys, ys + n, out);
+  for(auto p = n; p < m; ++p)
+    {
+      auto from_end = p - (n - 1), from_start = m - p;
+      auto i = (from_end <= from_start)? (n - 1 > from_end? n - 1 - from_end : 0) : std::min(from_start, n - 1);
+      out[p] = ys[i];
+    }
+}
+
+/**
+   in-place radix-2 transform of buffer_. Inverse is normalised.
+ */
+void ESRDenoiser::FFT(bool is_inverse)
+{
+  auto m = buffer_.size();
+  if(twiddles_.size() != m / 2)
+    {
+      twiddles_.resize(m / 2);
+      for(std::size_t k = 0; k < m / 2; ++k)
+        twiddles_[k] = std::polar(1.0, -2 * M_PI * k / m);
+    }
+
+  // bit reversal
+  for(std::size_t i = 1, j = 0; i < m; ++i)
+    {
+      auto bit = m >> 1;
+      for(; j & bit; bit >>= 1)
+        j ^= bit;
+      j ^= bit;
+      if(i < j)
+        std::swap(buffer_[i], buffer_[j]);
+    }
+
+  for(std::size_t len = 2; len <= m; len <<= 1)
+    {
+      auto step = m / len;
+      for(std::size_t i = 0; i < m; i += len)
+        for(std::size_t k = 0; k < len / 2; ++k)
+          {
+            auto w = is_inverse? std::conj(twiddles_[k * step]) : twiddles_[k * step];
+            auto u = buffer_[i + k];
+            auto v = buffer_[i + k + len / 2] * w;
+            buffer_[i + k] = u + v;
+            buffer_[i + k + len / 2] = u - v;
+          }
+    }
+
+  if(is_inverse)
+    for(auto& c : buffer_)
+      c /= static_cast<double>(m);
+}
+
+/**
+   low-pass of ys1 and ys2 (may be nullptr) by one complex transform:
+   the transfer function is real and even, so real and imaginary parts
+   are filtered independently.
+ */
+void ESRDenoiser::Filter(double* ys1, double* ys2, std::size_t n, double dx)
+{
+  auto m = GetExtendedSize(n);
+  work_.resize(2 * m);
+  Extend(ys1, n, m, work_.data());
+  if(ys2)
+    Extend(ys2, n, m, work_.data() + m);
+  else
+    std::fill(work_.begin() + m, work_.end(), 0.0);
+
+  buffer_.resize(m);
+  for(std::size_t i = 0; i < m; ++i)
+    buffer_[i] = {work_[i], work_[m + i]};
+
+  FFT(false);
+  auto df = 1 / (m * std::fabs(dx));
+  for(std::size_t k = 0; k < m; ++k)
+    {
+      auto f = std::min(k, m - k) * df;
+      buffer_[k] *= (mode_ == kGaussian)? std::exp(-2 * M_PI * M_PI * width_ * width_ * f * f)
+        : std::exp(-2 * M_PI * width_ * f);
+    }
+  FFT(true);
+
+  for(std::size_t i = 0; i < n; ++i)
+    {
+      ys1[i] = buffer_[i].real();
+      if(ys2)
+        ys2[i] = buffer_[i].imag();
+    }
+}
+
+/**
+   wavelet shrinkage of ys.
+ */
+void ESRDenoiser::Shrink(double* ys, std::size_t n)
+{
+  auto m = GetExtendedSize(n);
+  work_.resize(2 * m);
+  auto x = work_.data(), tmp = work_.data() + m;
+  Extend(ys, n, m, x);
+
+  auto len = m;
+  auto levels = 0;
+  for(; len >= 8 and levels < wavelet_levels; len /= 2, ++levels)
+    {
+      forward_step(x, len, tmp);
+      std::copy(tmp, tmp + len, x);
+    }
+
+  if(levels == 0)
+    return;
+
+  // noise from the finest details
+  std::vector<double> finest(x + m / 2, x + m);
+  for(auto& d : finest)
+    d = std::fabs(d);
+  auto mid = finest.begin() + finest.size() / 2;
+  std::nth_element(finest.begin(), mid, finest.end());
+  auto threshold = width_ * (*mid / 0.6745) * std::sqrt(2 * std::log(static_cast<double>(n)));
+
+  for(auto i = len; i < m; ++i)
+    {
+      auto d = std::fabs(x[i]) - threshold;
+      x[i] = (d > 0)? std::copysign(d, x[i]) : 0.0;
+    }
+
+  for(; levels > 0; --levels)
+    {
+      len *= 2;
+      std::copy(x, x + len, tmp);
+      inverse_step(tmp, len, x);
+    }
+  std::copy(x, x + n, ys);
+}
+
+/** denoise ys (n points with step dx) in place. */
+void ESRDenoiser::Apply(double* ys, std::size_t n, double dx)
+{
+  Apply(ys, nullptr, n, dx);
+}
+
+/** denoise ys1 and ys2 (may be nullptr) in place. */
+void ESRDenoiser::Apply(double* ys1, double* ys2, std::size_t n, double dx)
+{
+  if(n < 2 or not (width_ > 0))
+    return;
+  if(mode_ != kWavelet and not (dx != 0))
+    {
+      Warning("Apply", "step of x is 0.");
+      return;
+    }
+
+  if(mode_ == kWavelet)
+    {
+      Shrink(ys1, n);
+      if(ys2)
+        Shrink(ys2, n);
+    }
+  else
+    Filter(ys1, ys2, n, dx);
+}
@@ -0,0 +1,66 @@
+#ifndef ESRDenoiser_hh
+#define ESRDenoiser_hh
+
+#include <vector>
+#include <complex>
+#include <cstddef>
+
+/**
+   denoising of spectra without reduction of points, in place, O(n log n).
+
+   - kGaussian: FFT low-pass with the transfer function of a Gaussian
+     (convolution with a Gaussian of sigma = width).
+   - kLorentzian: the same with a Lorentzian of HWHM = width.
+     Broadening of lines is width (sigma or HWHM) added to them.
+   - kWavelet: Daubechies-4 wavelet transform, soft thresholding of detail
+     coefficients at width * sigma * sqrt(2 ln n) (universal threshold,
+     sigma from MAD of the finest details), inverse transform. O(n).
+     Narrow lines keep their shape better than low-pass.
+
+   Width is in unit of x (Gaussian, Lorentzian) or of the universal
+   threshold (wavelet). x is assumed to be uniform with step dx.
+
+   Spectra are extended by mirror images up to a power of two (at least 2n),
+   so that both ends are not mixed by the periodic transforms.
+   With the FFT, two spectra (e.g. real and imaginary parts) are filtered
+   by one complex transform.
+
+   \code{.cpp}
+   ESRDenoiser den{ESRDenoiser::kGaussian, 0.02}; // sigma: 0.02 mT
+   den.Apply(re.data(), im.data(), n, dx);
+   \endcode
+ */
+class ESRDenoiser
+{
+public:
+  enum Mode {kGaussian, kLorentzian, kWavelet};
+
+  static int wavelet_levels; // = 8. maximum number of levels of wavelet transform
+
+private:
+  Mode mode_;
+  double width_;
+
+  // work arrays, kept for the next call of the same size
+  std::vector<std::complex<double> > buffer_;
+  std::vector<std::complex<double> > twiddles_;
+  std::vector<double> work_;
+
+  void Extend(const double* ys, std::size_t n, std::size_t m, double* out) const;
+  void FFT(bool is_inverse);
+  void Filter(double* ys1, double* ys2, std::size_t n, double dx);
+  void Shrink(double* ys, std::size_t n);
+
+public:
+  ESRDenoiser(Mode mode = kGaussian, double width = 0);
+
+  Mode GetMode() const;
+  double GetWidth() const;
+
+  static std::size_t GetExtendedSize(std::size_t n);
+
+  void Apply(double* ys, std::size_t n, double dx);
+  void Apply(double* ys1, double* ys2, std::size_t n, double dx);
+};
+
+#endif
@@ -0,0 +1,243 @@
+#include "ESRFeatureDetector.hh"
+
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+
+#include "TError.h"
+
+double ESRFeatureDetector::threshold = 5;
+double ESRFeatureDetector::min_relative = 0.05;
+double ESRFeatureDetector::window_scale = 3;
+
+namespace
+{
+  /* run of points beyond the threshold of the same sign. */
+  struct Lobe
+  {
+    int sign;
+    std::size_t first;
+    std::size_t last; // inclusive
+    std::size_t peak;
+    double height;    // |y - level| at peak
+  };
+
+  double median(std::vector<double>& vals)
+  {
+    auto mid = vals.begin() + vals.size() / 2;
+    std::nth_element(vals.begin(), mid, vals.end());
+    return *mid;
+  }
+}
+
+ESRFeatureDetector::ESRFeatureDetector() :
+  level_(0), noise_(0)
+{}
+
+/**
+   detect lines of the derivative spectrum ys over xs.
+   @param xs x of points (ascending)
+   @param ys y of points
+ */
+ESRFeatureDetector::ESRFeatureDetector(Span<double> xs, Span<double> ys) :
+  level_(0), noise_(0)
+{
+  auto n = std::min(xs.size(), ys.size());
+  if(n < 3)
+    {
+      Warning("ESRFeatureDetector", "too few points: %zu", n);
+      return;
+    }
+  if(not std::is_sorted(xs.begin(), xs.begin() + n))
+    {
+      Warning("ESRFeatureDetector", "x is not in ascending order.");
+      return;
+    }
+
+  // level and noise: median and MAD of differences
+  std::vector<double> work(ys.begin(), ys.begin() + n);
+  level_ = median(work);
+  work.resize(n - 1);
+  for(std::size_t i = 0; i + 1 < n; ++i)
+    work[i] = ys[i + 1] - ys[i];
+  auto dmed = median(work);
+  for(auto& d : work)
+    d = std::fabs(d - dmed);
+  noise_ = 1.4826 * median(work) / std::sqrt(2.0);
+
+  auto ymax = 0.0;
+  for(std::size_t i = 0; i < n; ++i)
+    ymax = std::max(ymax, std::fabs(ys[i] - level_));
+  auto thr = std::max(threshold * noise_, min_relative * ymax);
+  if(not (thr > 0))
+    return;
+
+  // lobes
+  std::vector<Lobe> lobes;
+  for(std::size_t i = 0; i < n; ++i)
+    {
+      auto v = ys[i] - level_;
+      auto sign = (v > thr)? 1 : (v < -thr)? -1 : 0;
+      if(sign == 0)
+        continue;
+      if(lobes.empty() or lobes.back().sign != sign)
+        lobes.push_back({sign, i, i, i, std::fabs(v)});
+      auto& lobe = lobes.back();
+      lobe.last = i;
+      if(std::fabs(v) > lobe.height)
+        {
+          lobe.peak = i;
+          lobe.height = std::fabs(v);
+        }
+    }
+  if(lobes.size() < 2)
+    return;
+
+  /* pairs of adjacent lobes (opposite signs), narrowest first: the two
+     lobes of a line are closer than lobes of neighbouring lines.
+     A lobe belongs to one line at most. Lines of both phases are found
+     (e.g. sample and Mn marker). */
+  std::vector<std::size_t> pairs;
+  for(std::size_t k = 0; k + 1 < lobes.size(); ++k)
+    pairs.push_back(k);
+  std::sort(pairs.begin(), pairs.end(), [&](std::size_t k, std::size_t l)
+            {
+              return xs[lobes[k + 1].peak] - xs[lobes[k].peak] < xs[lobes[l + 1].peak] - xs[lobes[l].peak];
+            });
+  std::vector<bool> is_used(lobes.size(), false);
+
+  for(auto k : pairs)
+    {
+      if(is_used[k] or is_used[k + 1])
+        continue;
+      is_used[k] = is_used[k + 1] = true;
+      const auto& a = lobes[k];
+      const auto& b = lobes[k + 1];
+
+      // zero crossing of the straight line through the central part
+      auto cut = 0.5 * std::min(a.height, b.height);
+      auto x0 = 0.5 * (xs[a.peak] + xs[b.peak]);
+      double s = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+      for(auto i = a.peak; i <= b.peak; ++i)
+        {
+          auto v = ys[i] - level_;
+          if(std::fabs(v) >= cut)
+            continue;
+          auto dx = xs[i] - x0;
+          s += 1;
+          sx += dx;
+          sy += v;
+          sxx += dx * dx;
+          sxy += dx * v;
+        }
+      auto det = s * sxx - sx * sx;
+      auto slope = (s >= 2 and det > 0)? (s * sxy - sx * sy) / det : 0.0;
+      double center;
+      if(slope != 0)
+        center = x0 + (sx * slope - sy) / (s * slope); // intercept / -slope
+      else
+        {
+          // interpolation between the peaks
+          auto va = ys[a.peak] - level_, vb = ys[b.peak] - level_;
+          center = xs[a.peak] + (xs[b.peak] - xs[a.peak]) * va / (va - vb);
+        }
+      center = std::max(xs[a.peak], std::min(xs[b.peak], center));
+
+      auto width = xs[b.peak] - xs[a.peak];
+      lines_.push_back({center, width, a.height + b.height});
+
+      auto lower = std::min(center - window_scale * width, xs[a.first]);
+      auto upper = std::max(center + window_scale * width, xs[b.last]);
+      signal_windows_.push_back({std::max(lower, xs[0]), std::min(upper, xs[n - 1])});
+    }
+
+  std::sort(lines_.begin(), lines_.end(), [](const Line& a, const Line& b) {return a.center < b.center;});
+
+  // merge signal windows
+  std::sort(signal_windows_.begin(), signal_windows_.end());
+  std::vector<std::pair<double, double> > merged;
+  for(const auto& w : signal_windows_)
+    {
+      if(not merged.empty() and w.first <= merged.back().second)
+        merged.back().second = std::max(merged.back().second, w.second);
+      else
+        merged.push_back(w);
+    }
+  signal_windows_.swap(merged);
+
+  // background: the rest. noise in it
+  auto lower = xs[0];
+  for(const auto& w : signal_windows_)
+    {
+      if(w.first > lower)
+        background_windows_.push_back({lower, w.first});
+      lower = w.second;
+    }
+  if(lower < xs[n - 1])
+    background_windows_.push_back({lower, xs[n - 1]});
+
+  // differences of neighbouring points both in background: slow drift does not count
+  double sum2 = 0;
+  std::size_t ndiff = 0;
+  auto it = signal_windows_.cbegin();
+  auto is_prev_bg = false;
+  for(std::size_t i = 0; i < n; ++i)
+    {
+      while(it != signal_windows_.cend() and it->second < xs[i])
+        ++it;
+      auto is_bg = (it == signal_windows_.cend() or xs[i] < it->first);
+      if(is_bg and is_prev_bg)
+        {
+          auto d = ys[i] - ys[i - 1];
+          sum2 += d * d;
+          ++ndiff;
+        }
+      is_prev_bg = is_bg;
+    }
+  if(ndiff > 1)
+    noise_ = std::sqrt(0.5 * sum2 / ndiff);
+}
+
+/** baseline of the derivative spectrum (median of y). Zero crossings are measured from it. */
+double ESRFeatureDetector::GetLevel() const {return level_;}
+
+/** noise (sigma) from differences of points in background windows (robust estimate if no background). */
+double ESRFeatureDetector::GetNoise() const {return noise_;}
+
+const std::vector<ESRFeatureDetector::Line>& ESRFeatureDetector::GetLines() const {return lines_;}
+
+/** centers of lines in ascending order: e.g. for DipoleKernel::offset(). */
+std::vector<double> ESRFeatureDetector::GetCenters() const
+{
+  std::vector<double> centers;
+  centers.reserve(lines_.size());
+  for(const auto& line : lines_)
+    centers.push_back(line.center);
+  return centers;
+}
+
+/** windows {lower, upper} covering lines, merged. */
+const std::vector<std::pair<double, double> >& ESRFeatureDetector::GetSignalWindows() const
+{
+  return signal_windows_;
+}
+
+/** windows {lower, upper} out of signal windows: e.g. for ESR::SubtractPolynomialBaseline(). */
+const std::vector<std::pair<double, double> >& ESRFeatureDetector::GetBackgroundWindows() const
+{
+  return background_windows_;
+}
+
+void ESRFeatureDetector::Print() const
+{
+  std::cout << "level: " << level_ << std::endl
+            << "noise: " << noise_ << std::endl
+            << "lines: " << lines_.size() << std::endl;
+  for(const auto& line : lines_)
+    std::cout << "  center: " << line.center << "\twidth: " << line.width
+              << "\tamplitude: " << line.amplitude << std::endl;
+  for(const auto& w : signal_windows_)
+    std::cout << "signal window: " << w.first << "\tto\t" << w.second << std::endl;
+  for(const auto& w : background_windows_)
+    std::cout << "background window: " << w.first << "\tto\t" << w.second << std::endl;
+}
@@ -0,0 +1,70 @@
+#ifndef ESRFeatureDetector_hh
+#define ESRFeatureDetector_hh
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+#include "Span.hh"
+
+/**
+   lines of a derivative spectrum (as measured, not integrated), found in linear time.
+
+   1. level and noise: median of y, and MAD of differences of neighbouring
+      points (line shapes are smooth: differences are dominated by noise).
+   2. lobes: runs of points beyond level +- threshold * noise, one pass.
+      Runs of the same sign are merged.
+   3. lines: adjacent lobes of opposite signs, paired narrowest first
+      (lobes between neighbouring lines are farther apart than lobes of a line).
+      Lines of both phases are found, e.g. sample (+ -> -) and Mn marker.
+      The center is the zero crossing of a line fitted to points between
+      the two peaks with |y - level| < half of the smaller peak:
+      sub-sample position, as ESRLine::find() without windows given by hand.
+   4. windows: signal windows are center +- window_scale * peak-to-peak width
+      (and the lobes), merged. Background windows are the rest.
+      Noise is recalculated from differences of points in background windows.
+
+   Results are kept: x and y are not referred after construction.
+
+   \code{.cpp}
+   auto det = esr.DetectFeatures();
+   app->toffset(det.GetCenters());                          // DipoleKernel::offset()
+   esr.SubtractPolynomialBaseline(det.GetBackgroundWindows()); // background regions
+   \endcode
+ */
+class ESRFeatureDetector
+{
+public:
+  struct Line
+  {
+    double center;    // zero crossing
+    double width;     // peak-to-peak width (x of second peak - x of first peak)
+    double amplitude; // peak-to-peak height
+  };
+
+private:
+  double level_;
+  double noise_;
+  std::vector<Line> lines_;
+  std::vector<std::pair<double, double> > signal_windows_;
+  std::vector<std::pair<double, double> > background_windows_;
+
+public:
+  static double threshold;    // = 5. lobe threshold in noise (sigma)
+  static double min_relative; // = 0.05. lobe threshold at least this fraction of max |y - level|
+  static double window_scale; // = 3. half width of signal window in peak-to-peak width
+
+  ESRFeatureDetector();
+  ESRFeatureDetector(Span<double> xs, Span<double> ys);
+
+  double GetLevel() const;
+  double GetNoise() const;
+  const std::vector<Line>& GetLines() const;
+  std::vector<double> GetCenters() const;
+  const std::vector<std::pair<double, double> >& GetSignalWindows() const;
+  const std::vector<std::pair<double, double> >& GetBackgroundWindows() const;
+
+  void Print() const;
+};
+
+#endif
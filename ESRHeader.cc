@@ -22,6 +22,16 @@ ESRHeader::ESRHeader(const std::map<std::string, std::string>& key_val)
     header_dt_(std::make_shared<ESRHeaderDT>(key_val))
 {}
 
+/**
+   header made of sub-header objects already filled, e.g. by ESRBinaryHeader.
+ */
+ESRHeader::ESRHeader(std::shared_ptr<ESRHeaderDH> dh, std::shared_ptr<ESRHeaderGP> gp,
+                     std::shared_ptr<ESRHeaderSP> sp, std::shared_ptr<ESRHeaderAP> ap,
+                     std::shared_ptr<ESRHeaderDT> dt)
+  : header_dh_(std::move(dh)), header_gp_(std::move(gp)), header_sp_(std::move(sp)),
+    header_ap_(std::move(ap)), header_dt_(std::move(dt))
+{}
+
 ESRHeader::~ESRHeader()
 {
   header_dh_.reset();
@@ -67,6 +77,16 @@ void ESRHeader::SetAmplitude(std::pair<double, double> val, int type)
                            std::forward<int>(type));
 }
 
+/**
+   elements are shared with copies of the header:
+   acquisition parameter is copied before it is changed.
+ */
+void ESRHeader::SetAccumulationCount(int val)
+{
+  header_ap_ = std::make_shared<ESRHeaderAP>(*header_ap_);
+  header_ap_->SetAccumulationCount(val);
+}
+
 // print
 void ESRHeader::Print(Option_t* options) const
 {
@@ -37,6 +37,9 @@ class ESRHeader : public TObject
 public:
   ESRHeader();
   ESRHeader(const std::map<std::string, std::string>&); // map
+  ESRHeader(std::shared_ptr<ESRHeaderDH>, std::shared_ptr<ESRHeaderGP>,
+            std::shared_ptr<ESRHeaderSP>, std::shared_ptr<ESRHeaderAP>,
+            std::shared_ptr<ESRHeaderDT>); // typed
   ESRHeader(const ESRHeader&) = default;
   ~ESRHeader();
 
@@ -56,6 +59,7 @@ public:
   // setter
   void SetXrange(std::pair<double, double>);
   void SetAmplitude(std::pair<double, double>, int type = 1);
+  void SetAccumulationCount(int);
 
   // print function
   virtual void Print(Option_t* options = "") const final;
@@ -178,7 +178,7 @@ void ESRHeaderDH::set_val(const std::map<std::string, std::string>& key_val)
   file_name_ = this->mystos(key_val, "file name");
   data_number_ = this->mystoi(key_val, "data number");
   data_length_ = this->mystod(key_val, "data length");
-  data_sort_ = this->mystos(key_val, "data length");
+  data_sort_ = this->mystos(key_val, "data sort");
   x_range_min_ = this->mystod(key_val, "x-range min");
   x_range_ = this->mystod(key_val, "x-range");
   x_unit_ = this->mystos(key_val, "x unit");
@@ -424,6 +424,10 @@ void ESRHeaderAP::set_val(const std::map<std::string, std::string>& key_val)
   reserved_char_ = this->mystos(key_val, "reserved(char)");
 }
 
+int ESRHeaderAP::GetAccumulationCount() const {return accumu_count_;};
+
+void ESRHeaderAP::SetAccumulationCount(int val) {accumu_count_ = val;};
+
 void ESRHeaderAP::Print(Option_t*) const
 {
   std::cout << "sampling time: " << sampling_time_ << std::endl;
@@ -8,6 +8,8 @@
 
 #include "TObject.h"
 
+class ESRBinaryHeader;
+
 /**
    Classes manage header infomation.
    See each class definition.
@@ -62,6 +64,8 @@ class ESRHeaderDH : public ESRHeaderElement
 
   virtual void set_val(const std::map<std::string, std::string>&);
 
+  friend class ESRBinaryHeader; // fills fields directly
+
 public:
   ESRHeaderDH();
   ESRHeaderDH(const std::map<std::string, std::string>&);
@@ -98,6 +102,8 @@ class ESRHeaderGP : public ESRHeaderElement
 
   virtual void set_val(const std::map<std::string, std::string>&);
 
+  friend class ESRBinaryHeader; // fills fields directly
+
 public:
   ESRHeaderGP();
   ESRHeaderGP(const std::map<std::string, std::string>&);
@@ -202,6 +208,8 @@ class ESRHeaderSP : public ESRHeaderElement
   // method
   virtual void set_val(const std::map<std::string, std::string>&);
 
+  friend class ESRBinaryHeader; // fills fields directly
+
 public:
   ESRHeaderSP();
   ESRHeaderSP(const std::map<std::string, std::string>&);
@@ -242,11 +250,16 @@ class ESRHeaderAP : public ESRHeaderElement
 
   virtual void  set_val(const std::map<std::string, std::string>&);
 
+  friend class ESRBinaryHeader; // fills fields directly
+
 public:
   ESRHeaderAP();
   ESRHeaderAP(const std::map<std::string, std::string>&);
   ESRHeaderAP(const ESRHeaderAP&) = default;
 
+  int GetAccumulationCount() const;
+  void SetAccumulationCount(int val);
+
   virtual void Print(Option_t* options = "") const final;
 
   ClassDef(ESRHeaderAP, 1);
@@ -261,6 +274,8 @@ class ESRHeaderDT : public ESRHeaderElement
   int length_; // this should be same as "data length"
   virtual void set_val(const std::map<std::string, std::string>&);
 
+  friend class ESRBinaryHeader; // fills fields directly
+
 public:
   ESRHeaderDT();
   ESRHeaderDT(const std::map<std::string, std::string>&);
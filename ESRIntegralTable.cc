@@ -0,0 +1,111 @@
+#include "ESRIntegralTable.hh"
+#include "ESRIntegrator.hh"
+
+#include <algorithm>
+
+ESRIntegralTable::ESRIntegralTable() :
+  xs_(), ys_(), cumul_(), cumul2_(), is_sorted_(false)
+{}
+
+/**
+   build the table (see ESRIntegrator).
+   @param xs x of points (ascending). shared, not copied.
+   @param ys y of points. shared, not copied.
+ */
+ESRIntegralTable::ESRIntegralTable(const ESRBuffer<double>& xs, const ESRBuffer<double>& ys) :
+  xs_(xs), ys_(ys), cumul_(), cumul2_(), is_sorted_(true)
+{
+  const auto& x = xs_.Get();
+  const auto& y = ys_.Get();
+  auto n = std::min(x.size(), y.size());
+
+  is_sorted_ = std::is_sorted(x.cbegin(), x.cbegin() + n);
+
+  // cumul2[0] = 0, cumul2[k + 1] = cumul[0] + ... + cumul[k]
+  std::vector<double> cumul(n), cumul2(n + 1, 0);
+  ESRIntegrator::Trapezoid(x.data(), y.data(), n, cumul.data());
+  ESRIntegrator::PrefixSum(cumul.data(), n, cumul2.data() + 1);
+
+  cumul_.Assign(std::move(cumul));
+  cumul2_.Assign(std::move(cumul2));
+}
+
+bool ESRIntegralTable::IsEmpty() const {return cumul_.IsEmpty();}
+
+/** false if x is not ascending: ranges cannot be found by binary search. */
+bool ESRIntegralTable::IsSorted() const {return is_sorted_;}
+
+std::size_t ESRIntegralTable::GetSize() const {return cumul_.GetSize();}
+
+/**
+   points with start <= x <= end by binary search.
+   @return [first, last) indices. first == last if no point.
+ */
+std::pair<std::size_t, std::size_t> ESRIntegralTable::FindRange(double start, double end) const
+{
+  const auto& x = xs_.Get();
+  auto n = GetSize();
+  auto first = std::lower_bound(x.begin(), x.begin() + n, start) - x.begin();
+  auto last = std::upper_bound(x.begin(), x.begin() + n, end) - x.begin();
+  if(last < first)
+    last = first;
+  return {static_cast<std::size_t>(first), static_cast<std::size_t>(last)};
+}
+
+/** integral from x[0] to x[k]. */
+double ESRIntegralTable::GetCumulative(std::size_t k) const {return cumul_[k];}
+
+/** sum of GetCumulative(k) for k in [first, last). */
+double ESRIntegralTable::GetSumCumulative(std::size_t first, std::size_t last) const
+{
+  return cumul2_[last] - cumul2_[first];
+}
+
+/**
+   integral from x[0] to x: y is linear between points.
+   x is clipped to the range of points.
+ */
+double ESRIntegralTable::GetCumulativeAt(double x) const
+{
+  const auto& xs = xs_.Get();
+  const auto& ys = ys_.Get();
+  auto n = GetSize();
+
+  if(x <= xs[0])
+    return 0;
+  if(x >= xs[n - 1])
+    return cumul_[n - 1];
+
+  // xs[k - 1] < x <= xs[k]
+  std::size_t k = std::lower_bound(xs.begin(), xs.begin() + n, x) - xs.begin();
+  auto dx = x - xs[k - 1];
+  auto y = ys[k - 1] + (ys[k] - ys[k - 1]) * dx / (xs[k] - xs[k - 1]);
+  return cumul_[k - 1] + 0.5 * (ys[k - 1] + y) * dx;
+}
+
+/**
+   definite integral from start to end, interpolated at both edges.
+   Integral out of the range of points is 0.
+ */
+double ESRIntegralTable::GetDefinite(double start, double end) const
+{
+  if(IsEmpty())
+    return 0;
+  if(start > end)
+    return -GetDefinite(end, start);
+  return GetCumulativeAt(end) - GetCumulativeAt(start);
+}
+
+/**
+   view of running integral on points [first, last): cumul[k] + offset.
+ */
+ESRIntegralTable::View ESRIntegralTable::GetView(std::size_t first, std::size_t last, double offset) const
+{
+  View view;
+  if(first >= last or last > GetSize())
+    return view;
+  view.x = xs_.GetSpan().subspan(first, last - first);
+  view.cumul = cumul_.GetSpan().subspan(first, last - first);
+  view.offset = offset;
+  return view;
+}
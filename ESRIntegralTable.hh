@@ -0,0 +1,74 @@
+#ifndef ESRIntegralTable_hh
+#define ESRIntegralTable_hh
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+#include "Span.hh"
+#include "ESRBuffer.hh"
+
+/**
+   prefix table of trapezoidal integral for range integrals in O(log n).
+
+   cumul[k] is the integral from x[0] to x[k] (cumul[0] = 0), and
+   cumul2[k] is the sum of cumul[0] ... cumul[k - 1].
+   Any range of the running integral is an offset of cumul, and the sum of
+   it over a range is a difference of cumul2: no walk over the spectrum.
+   x and y are shared with the owner (copy-on-write buffers): no copy.
+
+   \code{.cpp}
+   ESRIntegralTable table{xs, ys}; // once, O(n)
+   auto area = table.GetDefinite(330, 340); // O(log n)
+   auto range = table.FindRange(330, 340);
+   auto part = table.GetView(range.first, range.second, 0); // offset view of cumul
+   for(auto i = 0ul; i < part.size(); ++i)
+     gr->SetPoint(i, part.x[i], part[i]);
+   \endcode
+
+   x must be in ascending order: see IsSorted().
+ */
+class ESRIntegralTable
+{
+public:
+  /**
+     running integral on points [first, last): cumul + offset. No copy.
+     Valid while the table (or its owner) is alive and unchanged.
+   */
+  struct View
+  {
+    Span<double> x;
+    Span<double> cumul;
+    double offset = 0;
+
+    std::size_t size() const {return x.size();}
+    bool empty() const {return x.empty();}
+    double operator[](std::size_t i) const {return cumul[i] + offset;}
+  };
+
+private:
+  ESRBuffer<double> xs_;
+  ESRBuffer<double> ys_;
+  ESRBuffer<double> cumul_;
+  ESRBuffer<double> cumul2_;
+  bool is_sorted_;
+
+  double GetCumulativeAt(double x) const;
+
+public:
+  ESRIntegralTable();
+  ESRIntegralTable(const ESRBuffer<double>& xs, const ESRBuffer<double>& ys);
+
+  bool IsEmpty() const;
+  bool IsSorted() const;
+  std::size_t GetSize() const;
+
+  std::pair<std::size_t, std::size_t> FindRange(double start, double end) const;
+
+  double GetCumulative(std::size_t k) const;
+  double GetSumCumulative(std::size_t first, std::size_t last) const;
+  double GetDefinite(double start, double end) const;
+  View GetView(std::size_t first, std::size_t last, double offset) const;
+};
+
+#endif
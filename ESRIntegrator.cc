@@ -0,0 +1,148 @@
+#include "ESRIntegrator.hh"
+
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+  const std::size_t block = 256;
+
+  /**
+     trapezoid increments of n points: y and x from index -1.
+     A full block has a constant trip count: vectorized with the cost model of -O2.
+   */
+  inline void trapezoid_increments(const double* x, const double* y, std::size_t n, double* dx, double* inc)
+  {
+    if(n == block)
+      for(std::size_t i = 0; i < block; ++i)
+        {
+          dx[i] = x[i] - x[i - 1];
+          inc[i] = 0.5 * (y[i] + y[i - 1]) * dx[i];
+        }
+    else
+      for(std::size_t i = 0; i < n; ++i)
+        {
+          dx[i] = x[i] - x[i - 1];
+          inc[i] = 0.5 * (y[i] + y[i - 1]) * dx[i];
+        }
+  }
+
+  inline void rectangle_increments(double dx, const double* y, std::size_t n, double* inc)
+  {
+    if(n == block)
+      for(std::size_t i = 0; i < block; ++i)
+        inc[i] = dx * y[i];
+    else
+      for(std::size_t i = 0; i < n; ++i)
+        inc[i] = dx * y[i];
+  }
+
+  /**
+     compensated sum (Neumaier). Lost low-order bits are kept in c.
+     Must not be compiled with -ffast-math.
+   */
+  struct Sum
+  {
+    double s;
+    double c;
+
+    Sum(double init) : s(init), c(0) {}
+
+    void Add(double v)
+    {
+      auto t = s + v;
+      if(std::fabs(s) >= std::fabs(v))
+        c += (s - t) + v;
+      else
+        c += (v - t) + s;
+      s = t;
+    }
+
+    double Get() const {return s + c;}
+  };
+}
+
+const std::size_t ESRIntegrator::block_size = block;
+
+/**
+   running trapezoidal integral(s) of ys over xs.
+
+   @param first output: first integral (n points). first[0] = c1.
+   @param second output: second integral (n points), or nullptr. second[0] = c2.
+ */
+void ESRIntegrator::Trapezoid(const double* xs, const double* ys, std::size_t n,
+                              double* first, double* second, double c1, double c2)
+{
+  if(n == 0)
+    return;
+
+  Sum sum1{c1}, sum2{c2};
+  first[0] = c1;
+  if(second)
+    second[0] = c2;
+
+  double inc[block], dx[block];
+  auto prev = c1;
+  for(std::size_t k0 = 1; k0 < n; k0 += block)
+    {
+      auto m = std::min(block, n - k0);
+      trapezoid_increments(xs + k0, ys + k0, m, dx, inc);
+
+      for(std::size_t i = 0; i < m; ++i)
+        {
+          sum1.Add(inc[i]);
+          auto val = sum1.Get();
+          first[k0 + i] = val;
+          if(second)
+            {
+              sum2.Add(0.5 * (val + prev) * dx[i]);
+              second[k0 + i] = sum2.Get();
+            }
+          prev = val;
+        }
+    }
+}
+
+/**
+   running rectangular integral(s) of ys with uniform step dx.
+
+   @param first output: first integral (n points). first[k] = c1 + dx * sum of ys[0 ... k].
+   @param second output: second integral (n points), or nullptr.
+ */
+void ESRIntegrator::Rectangle(double dx, const double* ys, std::size_t n,
+                              double* first, double* second, double c1, double c2)
+{
+  Sum sum1{c1}, sum2{c2};
+
+  double inc[block];
+  for(std::size_t k0 = 0; k0 < n; k0 += block)
+    {
+      auto m = std::min(block, n - k0);
+      rectangle_increments(dx, ys + k0, m, inc);
+
+      for(std::size_t i = 0; i < m; ++i)
+        {
+          sum1.Add(inc[i]);
+          auto val = sum1.Get();
+          first[k0 + i] = val;
+          if(second)
+            {
+              sum2.Add(dx * val);
+              second[k0 + i] = sum2.Get();
+            }
+        }
+    }
+}
+
+/**
+   sums[k] = init + vals[0] + ... + vals[k], compensated.
+ */
+void ESRIntegrator::PrefixSum(const double* vals, std::size_t n, double* sums, double init)
+{
+  Sum sum{init};
+  for(std::size_t k = 0; k < n; ++k)
+    {
+      sum.Add(vals[k]);
+      sums[k] = sum.Get();
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef ESRIntegrator_hh
+#define ESRIntegrator_hh
+
+#include <cstddef>
+
+/**
+   running first and second integrals of a spectrum in one pass.
+
+   All integrals of ESR (reduced data, partial integrals, prefix tables)
+   and ESRData (histograms for the Mn marker) are calculated here.
+
+   - Trapezoid(): x may be non-uniform (ESR).
+     first[0] = c1, first[k] = first[k - 1] + (y[k] + y[k - 1]) / 2 * (x[k] - x[k - 1]).
+   - Rectangle(): uniform step dx (ESRData, bins of histogram).
+     first[k] = c1 + dx * (y[0] + ... + y[k]).
+
+   The second integral is the same rule applied to the first one, with c2.
+   Increments are calculated block by block in a loop without dependency
+   (vectorized by compiler), and summed up with compensated (Neumaier)
+   summation: no error growing with the number of points.
+
+   \code{.cpp}
+   std::vector<double> first(n), second(n);
+   ESRIntegrator::Trapezoid(xs.data(), ys.data(), n, first.data(), second.data());
+   \endcode
+ */
+class ESRIntegrator
+{
+public:
+  static const std::size_t block_size; // = 256. points of increments calculated at once
+
+  static void Trapezoid(const double* xs, const double* ys, std::size_t n,
+                        double* first, double* second = nullptr, double c1 = 0, double c2 = 0);
+  static void Rectangle(double dx, const double* ys, std::size_t n,
+                        double* first, double* second = nullptr, double c1 = 0, double c2 = 0);
+  static void PrefixSum(const double* vals, std::size_t n, double* sums, double init = 0);
+};
+
+#endif
@@ -11,8 +11,14 @@ ESRLine::~ESRLine(){
 }
 
 double ESRLine::find( const double& min, const double& max ){
-  TFitResultPtr ptr = graph_->Fit( "pol1", "QS+", "", min, max );
+  // "N": fit function is not appended to the graph on every call
+  TFitResultPtr ptr = GetGraph()->Fit( "pol1", "QSN", "", min, max );
   return - ptr.Get()->Value( 0 ) / ptr.Get()->Value( 1 );
 }
 
+// centers of all lines by ESRFeatureDetector, in ascending order
+std::vector< double > ESRLine::find(){
+  return DetectFeatures().GetCenters();
+}
+
 ClassImp( ESRLine );
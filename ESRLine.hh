@@ -9,6 +9,7 @@ public:
   virtual ~ESRLine();
 
   double find( const double& min, const double& max );
+  std::vector< double > find(); // all lines, no window needed
   
 private:
 
@@ -0,0 +1,94 @@
+#include "ESRRawFile.hh"
+#include "MappedFile.hh"
+
+#include <cstring> // memcpy
+#include <algorithm>
+
+#include "TError.h"
+
+
+const std::size_t ESRRawFile::data_offset = 0x251c;
+const std::size_t ESRRawFile::data_length_offset = 0x56;
+
+/**
+   map the file and read data length.
+
+   When the file is shorter than the length written in the header,
+   data length is truncated to what is actually stored in both blocks.
+   The imaginary block still starts at the length in the header.
+ */
+ESRRawFile::ESRRawFile(const std::string& path) :
+  file_(std::make_shared<MappedFile>(path)), data_length_(0), imag_offset_(0)
+{
+  if(not file_->IsOpen())
+    return;
+
+  if(file_->GetSize() < data_offset)
+    {
+      Error("ESRRawFile::ESRRawFile", "%s is too small for raw binary file", path.c_str());
+      return;
+    }
+
+  // little endian as well as x86: no byte swap needed.
+  std::memcpy(&data_length_, file_->GetData() + data_length_offset, sizeof(int));
+
+  // two channels (real and imaginary part) follow the header
+  auto nfloats = static_cast<long>((file_->GetSize() - data_offset) / sizeof(float));
+  auto length = static_cast<long>(data_length_);
+  data_length_ = 0;
+  if(length < 0 or length >= nfloats)
+    {
+      Error("ESRRawFile::ESRRawFile",
+            "data length %ld in header does not fit in %s (%ld floats).", length, path.c_str(), nfloats);
+      return;
+    }
+
+  imag_offset_ = static_cast<int>(length);
+  data_length_ = static_cast<int>(std::min(length, nfloats - length));
+  if(data_length_ < length)
+    Warning("ESRRawFile::ESRRawFile",
+            "data length %ld in header exceeds file size. -> %d", length, data_length_);
+}
+
+bool ESRRawFile::IsOpen() const {return file_->IsOpen() and file_->GetSize() >= data_offset;}
+
+int ESRRawFile::GetDataLength() const {return data_length_;}
+
+std::shared_ptr<MappedFile> ESRRawFile::GetMappedFile() const {return file_;}
+
+/**
+   span of real part, float as written in the file.
+   data_offset (0x251c) is multiple of 4 so that float access is aligned.
+ */
+Span<float> ESRRawFile::GetReal() const {return GetY(false);}
+
+Span<float> ESRRawFile::GetImag() const {return GetY(true);}
+
+Span<float> ESRRawFile::GetY(bool is_imag) const
+{
+  if(not IsOpen())
+    return Span<float>{};
+
+  auto head = reinterpret_cast<const float*>(file_->GetData() + data_offset);
+  return Span<float>{head + (is_imag? imag_offset_ : 0), static_cast<std::size_t>(data_length_)};
+}
+
+/**
+   convert channel to double, divided by gain. gain = 1 gives raw value.
+ */
+std::vector<double> ESRRawFile::Convert(bool is_imag, double gain) const
+{
+  std::vector<double> v(data_length_);
+  Convert(v.data(), is_imag, gain);
+  return v;
+}
+
+/**
+   same as above, but write into out, which must hold GetDataLength() elements.
+ */
+void ESRRawFile::Convert(double* out, bool is_imag, double gain) const
+{
+  auto ys = GetY(is_imag);
+  for(std::size_t i = 0, n = ys.size(); i < n; ++i)
+    out[i] = static_cast<double>(ys[i]) / gain;
+}
@@ -0,0 +1,52 @@
+#ifndef ESRRawFile_hh
+#define ESRRawFile_hh
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "Span.hh"
+
+class MappedFile;
+
+/**
+   zero-copy access to raw binary file (file type 3) of the spectrometer.
+
+   The file is memory mapped. Opening costs only reading the data length
+   in the header: the real and imaginary blocks stored as float at 0x251c
+   are exposed as read-only spans, and converted (or normalised) to double
+   only when Convert() is called.
+
+   \code{.cpp}
+   ESRRawFile raw{"data.bin"};
+   auto re = raw.GetReal(); // Span<float>, no copy
+   auto y_norm = raw.Convert(false, gain); // std::vector<double>
+   \endcode
+
+   Spans are valid as long as this object (or the shared MappedFile) lives.
+ */
+class ESRRawFile
+{
+  std::shared_ptr<MappedFile> file_;
+  int data_length_;
+  int imag_offset_; // imaginary block starts here (in floats): data length in the header
+
+public:
+  static const std::size_t data_offset; // = 0x251c
+  static const std::size_t data_length_offset; // = 0x56
+
+  ESRRawFile(const std::string& path);
+
+  bool IsOpen() const;
+  int GetDataLength() const;
+  std::shared_ptr<MappedFile> GetMappedFile() const;
+
+  Span<float> GetReal() const;
+  Span<float> GetImag() const;
+  Span<float> GetY(bool is_imag = false) const;
+
+  std::vector<double> Convert(bool is_imag = false, double gain = 1) const;
+  void Convert(double* out, bool is_imag = false, double gain = 1) const;
+};
+
+#endif
@@ -0,0 +1,339 @@
+#include "ESRResampler.hh"
+
+#include <cmath>
+#include <algorithm>
+#include <future>
+#include <thread>
+
+#include "TError.h"
+
+#include "ESR.hh"
+
+int ESRResampler::lanczos_order = 3;
+double ESRResampler::out_of_range = 0;
+unsigned int ESRResampler::nthreads = 0;
+
+namespace
+{
+  double sinc(double x)
+  {
+    return (x == 0)? 1.0 : std::sin(M_PI * x) / (M_PI * x);
+  }
+
+  /* weight of a source point at distance d (in points) from the target. */
+  double kernel(ESRResampler::Method method, double d, int order)
+  {
+    d = std::fabs(d);
+    switch(method)
+      {
+      case ESRResampler::kLinear:
+        return (d < 1)? 1 - d : 0.0;
+      case ESRResampler::kCubic:
+        {
+          const double a = -0.5;
+          if(d <= 1)
+            return ((a + 2) * d - (a + 3)) * d * d + 1;
+          if(d < 2)
+            return ((a * d - 5 * a) * d + 8 * a) * d - 4 * a;
+          return 0.0;
+        }
+      case ESRResampler::kLanczos:
+        return (d < order)? sinc(d) * sinc(d / order) : 0.0;
+      }
+    return 0.0;
+  }
+
+  /* func(begin, end) over [0, n) on several threads. The first chunk runs on this thread. */
+  template <typename Func>
+  void parallel_for(std::size_t n, unsigned int nthreads, Func func)
+  {
+    std::size_t nth = nthreads? nthreads : std::thread::hardware_concurrency();
+    auto nchunks = std::max<std::size_t>(1, std::min<std::size_t>(nth, n));
+
+    std::vector<std::future<void> > futures;
+    futures.reserve(nchunks - 1);
+    for(auto ichunk = 1ul; ichunk < nchunks; ++ichunk)
+      futures.push_back(std::async(std::launch::async, func,
+                                   ichunk * n / nchunks, (ichunk + 1) * n / nchunks));
+    if(n > 0)
+      func(0, n / nchunks);
+
+    // exception thrown in the thread is re-thrown here.
+    for(auto& f : futures)
+      f.get();
+  }
+}
+
+/**
+   @param axis target points, in mT (kField) or g-factor (kG)
+   @param kind kField or kG
+   @param method kLinear, kCubic or kLanczos
+ */
+ESRResampler::ESRResampler(const std::vector<double>& axis, Axis kind, Method method) :
+  axis_(axis), kind_(kind), method_(method), reference_frequency_(0)
+{}
+
+/** uniform target axis of n points from min to max (both included). */
+ESRResampler::ESRResampler(std::size_t n, double min, double max, Axis kind, Method method) :
+  axis_(n), kind_(kind), method_(method), reference_frequency_(0)
+{
+  for(std::size_t i = 0; i < n; ++i)
+    axis_[i] = (n > 1)? min + (max - min) * i / (n - 1) : min;
+}
+
+/**
+   g-factor of field (mT) at microwave frequency (MHz): g = h f / (mu_B B).
+   ESRData::bToG() is this at the frequency of the data.
+ */
+double ESRResampler::FieldToG(double field, double frequency)
+{
+  const double mu_B = 5.7883818066E-11;         // MeV T^{-1}
+  const double hc   = 197.3269718 * 2.0 * M_PI; // MeV fm
+  const double c    = 2.99792458E+8;            // m s^{-1}
+  const double muB_c = mu_B * c;
+  const double A    =  hc * 1.0E-6 / muB_c;
+
+  return A * frequency / field;
+}
+
+/** field (mT) of g-factor at microwave frequency (MHz). The same relation as FieldToG. */
+double ESRResampler::GToField(double g, double frequency)
+{
+  return FieldToG(g, frequency);
+}
+
+const std::vector<double>& ESRResampler::GetAxis() const {return axis_;}
+ESRResampler::Axis ESRResampler::GetAxisKind() const {return kind_;}
+ESRResampler::Method ESRResampler::GetMethod() const {return method_;}
+
+/** number of source points used for one target point. */
+int ESRResampler::GetTaps() const
+{
+  switch(method_)
+    {
+    case kLinear: return 2;
+    case kCubic: return 4;
+    case kLanczos: return 2 * std::max(1, lanczos_order);
+    }
+  return 2;
+}
+
+/**
+   field axis (kField) at this frequency (MHz): sources at other frequencies
+   are scaled to the same g-factor. 0: no scaling (default).
+ */
+void ESRResampler::SetReferenceFrequency(double frequency) {reference_frequency_ = frequency;}
+double ESRResampler::GetReferenceFrequency() const {return reference_frequency_;}
+
+/**
+   index/weight table from source axis xs (mT, ascending) to the target axis.
+   @param frequency microwave frequency (MHz) of the source: needed for kG,
+   and for kField with reference frequency.
+ */
+ESRResampler::Table ESRResampler::MakeTable(Span<double> xs, double frequency) const
+{
+  Table table;
+  auto n = xs.size();
+  auto m = axis_.size();
+  auto method = method_;
+  table.taps = GetTaps();
+  if(n < static_cast<std::size_t>(table.taps) and n >= 2 and method != kLinear)
+    {
+      Warning("MakeTable", "too few points for %d taps: %zu. linear interpolation is used.", table.taps, n);
+      method = kLinear;
+      table.taps = 2;
+    }
+  table.first.assign(m, npos);
+  table.weights.assign(m * table.taps, 0.0);
+
+  if(n < 2)
+    {
+      Warning("MakeTable", "too few points: %zu", n);
+      return table;
+    }
+  if(not std::is_sorted(xs.begin(), xs.end()))
+    {
+      Warning("MakeTable", "x is not in ascending order.");
+      return table;
+    }
+  if(kind_ == kG and not (frequency > 0))
+    {
+      Warning("MakeTable", "frequency is not given for g-factor axis.");
+      return table;
+    }
+
+  auto scale = (kind_ == kField and reference_frequency_ > 0 and frequency > 0)?
+    frequency / reference_frequency_ : 1.0;
+  auto taps = table.taps;
+  auto last_first = static_cast<long>(n) - taps;
+
+  for(std::size_t j = 0; j < m; ++j)
+    {
+      auto x = (kind_ == kG)? GToField(axis_[j], frequency) : axis_[j] * scale;
+      if(not (x >= xs.front() and x <= xs.back()))
+        continue;
+
+      // fractional index u of x
+      auto i = static_cast<std::size_t>(std::upper_bound(xs.begin(), xs.end(), x) - xs.begin());
+      i = std::min(std::max<std::size_t>(i, 1), n - 1) - 1;
+      auto dx = xs[i + 1] - xs[i];
+      auto u = i + ((dx > 0)? (x - xs[i]) / dx : 0.0);
+
+      // taps around u, folded onto the end points
+      auto first = static_cast<long>(i) - (taps / 2 - 1);
+      auto folded = std::max(0l, std::min(last_first, first));
+      auto w = table.weights.data() + j * taps;
+      double sum = 0;
+      for(auto k = 0; k < taps; ++k)
+        {
+          auto p = first + k;
+          auto wk = kernel(method, u - p, lanczos_order);
+          auto q = std::max(0l, std::min(static_cast<long>(n) - 1, p));
+          w[q - folded] += wk;
+          sum += wk;
+        }
+      if(method == kLanczos and sum != 0)
+        for(auto k = 0; k < taps; ++k)
+          w[k] /= sum;
+      table.first[j] = folded;
+    }
+
+  return table;
+}
+
+template <int taps>
+void ESRResampler::ApplyTaps(const Table& table, const double* ys, double* out)
+{
+  auto m = table.first.size();
+  auto w = table.weights.data();
+  for(std::size_t j = 0; j < m; ++j, w += taps)
+    {
+      auto first = table.first[j];
+      if(first == npos)
+        {
+          out[j] = out_of_range;
+          continue;
+        }
+      double sum = 0;
+      for(auto k = 0; k < taps; ++k)
+        sum += w[k] * ys[first + k];
+      out[j] = sum;
+    }
+}
+
+/**
+   resample ys (on the source axis of table) into out (size of the target axis).
+ */
+void ESRResampler::Apply(const Table& table, Span<double> ys, double* out)
+{
+  auto m = table.first.size();
+  if(m == 0)
+    return;
+  // table of the other axis would read out of ys
+  auto need = 0ul;
+  for(auto first : table.first)
+    if(first != npos)
+      need = std::max(need, first + table.taps);
+  if(need > ys.size())
+    {
+      Error("Apply", "table needs %zu points, but %zu given.", need, ys.size());
+      std::fill(out, out + m, out_of_range);
+      return;
+    }
+
+  // fixed number of taps: inner loop is unrolled
+  switch(table.taps)
+    {
+    case 2: ApplyTaps<2>(table, ys.data(), out); break;
+    case 4: ApplyTaps<4>(table, ys.data(), out); break;
+    case 6: ApplyTaps<6>(table, ys.data(), out); break;
+    case 8: ApplyTaps<8>(table, ys.data(), out); break;
+    default:
+      {
+        auto w = table.weights.data();
+        for(std::size_t j = 0; j < m; ++j, w += table.taps)
+          {
+            auto first = table.first[j];
+            double sum = 0;
+            if(first != npos)
+              for(auto k = 0; k < table.taps; ++k)
+                sum += w[k] * ys[first + k];
+            out[j] = (first == npos)? out_of_range : sum;
+          }
+      }
+    }
+}
+
+std::vector<double> ESRResampler::Apply(const Table& table, Span<double> ys)
+{
+  std::vector<double> out(table.first.size());
+  Apply(table, ys, out.data());
+  return out;
+}
+
+/** resample ys over xs (mT) at frequency (MHz). */
+std::vector<double> ESRResampler::Resample(Span<double> xs, Span<double> ys, double frequency) const
+{
+  return Apply(MakeTable(xs, frequency), ys);
+}
+
+/** resample reduced data of esr. Frequency is taken from its header. */
+std::vector<double> ESRResampler::Resample(const ESR& esr, bool is_norm, bool is_imag) const
+{
+  return Resample(esr.GetXSpan(), esr.GetYSpan(is_norm, is_imag), esr.GetFrequency());
+}
+
+/**
+   resample reduced data of spectra, one output per spectrum (in order).
+
+   Spectra of the same source axis and frequency share one table.
+   Tables are made and applied on several threads (nthreads).
+ */
+std::vector<std::vector<double> > ESRResampler::Resample(const std::vector<const ESR*>& spectra,
+                                                         bool is_norm, bool is_imag) const
+{
+  auto nspectra = spectra.size();
+  std::vector<std::vector<double> > outputs(nspectra);
+
+  /* products of ESR are made lazily (not thread safe): spans are taken here.
+     Source axes of the same size, ends and frequency are compared point by point. */
+  std::vector<Span<double> > xs(nspectra), ys(nspectra);
+  std::vector<double> frequencies(nspectra, 0);
+  std::vector<std::size_t> table_index(nspectra, 0);
+  std::vector<std::size_t> unique; // spectrum of each table
+  for(std::size_t s = 0; s < nspectra; ++s)
+    {
+      if(not spectra[s])
+        {
+          Error("Resample", "spectrum %zu is null.", s);
+          return {};
+        }
+      xs[s] = spectra[s]->GetXSpan();
+      ys[s] = spectra[s]->GetYSpan(is_norm, is_imag);
+      frequencies[s] = spectra[s]->GetFrequency();
+
+      auto it = std::find_if(unique.cbegin(), unique.cend(), [&](std::size_t t)
+                             {
+                               return frequencies[t] == frequencies[s] and xs[t].size() == xs[s].size()
+                                 and std::equal(xs[t].begin(), xs[t].end(), xs[s].begin());
+                             });
+      table_index[s] = it - unique.cbegin();
+      if(it == unique.cend())
+        unique.push_back(s);
+    }
+
+  std::vector<Table> tables(unique.size());
+  parallel_for(unique.size(), nthreads, [&](std::size_t begin, std::size_t end)
+               {
+                 for(auto t = begin; t < end; ++t)
+                   tables[t] = MakeTable(xs[unique[t]], frequencies[unique[t]]);
+               });
+
+  parallel_for(nspectra, nthreads, [&](std::size_t begin, std::size_t end)
+               {
+                 for(auto s = begin; s < end; ++s)
+                   outputs[s] = Apply(tables[table_index[s]], ys[s]);
+               });
+
+  return outputs;
+}
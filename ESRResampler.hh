@@ -0,0 +1,92 @@
+#ifndef ESRResampler_hh
+#define ESRResampler_hh
+
+#include <vector>
+#include <cstddef>
+
+#include "Span.hh"
+
+class ESR;
+
+/**
+   resampling of spectra onto a common axis of magnetic field (mT) or g-factor.
+
+   For a source axis (and microwave frequency), an index/weight table is
+   built once: for every target point, the first source point and the
+   weights of taps consecutive points. Applying the table is a fixed-length
+   dot product per point, shared by all spectra of the same source axis
+   (e.g. real and imaginary parts, or scans of the same sweep).
+
+   - kLinear: 2 taps.
+   - kCubic: 4 taps, Keys cubic convolution (a = -0.5).
+   - kLanczos: 2 * lanczos_order taps, windowed sinc (band-limited),
+     weights normalised to 1.
+
+   Interpolation is in fractional index of the source axis: cubic and
+   Lanczos assume the axis to be (locally) uniform, as the field sweep is.
+   Taps beyond both ends are folded onto the end points.
+   Target points out of the source axis are set to out_of_range.
+
+   Field axis is aligned by microwave frequency when reference frequency is given:
+   target B at the reference frequency is the same g-factor as B * f / f_ref at f.
+
+   \code{.cpp}
+   ESRResampler rs{1000, 1.98, 2.02, ESRResampler::kG, ESRResampler::kCubic};
+   auto ys = rs.Resample({&esr1, &esr2, &esr3}); // one spectrum per ESR, on threads
+   \endcode
+ */
+class ESRResampler
+{
+public:
+  enum Axis {kField, kG};
+  enum Method {kLinear, kCubic, kLanczos};
+
+  /** index/weight table for one source axis */
+  struct Table
+  {
+    std::vector<std::size_t> first; // first source point, npos: out of range
+    std::vector<double> weights;     // taps weights per target point
+    int taps;
+  };
+
+  static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+  static int lanczos_order;     // = 3. half number of taps of kLanczos
+  static double out_of_range;   // = 0. value of target points out of the source axis
+  /** number of threads. 0: std::thread::hardware_concurrency() */
+  static unsigned int nthreads;
+
+private:
+  std::vector<double> axis_;
+  Axis kind_;
+  Method method_;
+  double reference_frequency_;
+
+  template <int taps>
+  static void ApplyTaps(const Table& table, const double* ys, double* out);
+
+public:
+  ESRResampler(const std::vector<double>& axis, Axis kind = kField, Method method = kLinear);
+  ESRResampler(std::size_t n, double min, double max, Axis kind = kField, Method method = kLinear);
+
+  static double FieldToG(double field, double frequency);
+  static double GToField(double g, double frequency);
+
+  const std::vector<double>& GetAxis() const;
+  Axis GetAxisKind() const;
+  Method GetMethod() const;
+  int GetTaps() const;
+  void SetReferenceFrequency(double frequency);
+  double GetReferenceFrequency() const;
+
+  Table MakeTable(Span<double> xs, double frequency = 0) const;
+  static void Apply(const Table& table, Span<double> ys, double* out);
+  static std::vector<double> Apply(const Table& table, Span<double> ys);
+
+  std::vector<double> Resample(Span<double> xs, Span<double> ys, double frequency = 0) const;
+  std::vector<double> Resample(const ESR& esr, bool is_norm = false, bool is_imag = false) const;
+  std::vector<std::vector<double> > Resample(const std::vector<const ESR*>& spectra,
+                                             bool is_norm = false, bool is_imag = false) const;
+};
+
+#endif
@@ -0,0 +1,57 @@
+#include "ESRStream.hh"
+
+/**
+   one slot is kept empty to distinguish full from empty.
+ */
+ESRStream::ESRStream(std::size_t capacity) :
+  ring_(capacity + 1), head_(0), tail_(0), dropped_(0)
+{}
+
+/**
+   producer side. Never blocks.
+
+   @return false if the queue is full. The block is dropped then.
+ */
+bool ESRStream::Push(ESRBlock&& block)
+{
+  auto tail = tail_.load(std::memory_order_relaxed);
+  auto next = (tail + 1) % ring_.size();
+  if(next == head_.load(std::memory_order_acquire))
+    {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+  ring_[tail] = std::move(block);
+  tail_.store(next, std::memory_order_release);
+  return true;
+}
+
+/**
+   consumer side.
+
+   @return false if the queue is empty.
+ */
+bool ESRStream::Pop(ESRBlock& block)
+{
+  auto head = head_.load(std::memory_order_relaxed);
+  if(head == tail_.load(std::memory_order_acquire))
+    return false;
+
+  // swap: buffers of the popped block go back to the ring.
+  std::swap(block, ring_[head]);
+  head_.store((head + 1) % ring_.size(), std::memory_order_release);
+  return true;
+}
+
+std::size_t ESRStream::GetCapacity() const {return ring_.size() - 1;}
+
+/**
+   number of blocks dropped because the queue was full.
+ */
+std::size_t ESRStream::GetDropped() const {return dropped_.load(std::memory_order_relaxed);}
+
+bool ESRStream::IsEmpty() const
+{
+  return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+}
@@ -0,0 +1,53 @@
+#ifndef ESRStream_hh
+#define ESRStream_hh
+
+#include <vector>
+#include <atomic>
+#include <cstddef>
+
+/**
+   block of samples acquired at once. x and y_imag may be empty.
+ */
+struct ESRBlock
+{
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> y_imag;
+};
+
+/**
+   bounded single-producer/single-consumer queue of ESRBlock.
+
+   Lock free: the acquisition thread calls Push(), which never blocks
+   (a block is dropped and counted when the queue is full),
+   and the analysis thread calls Pop(), or ESR::Consume().
+
+   \code{.cpp}
+   ESRStream stream{64};
+   // acquisition thread
+   stream.Push(std::move(block));
+   // analysis thread
+   esr.Consume(stream); // ESR::Append for all queued blocks
+   \endcode
+ */
+class ESRStream
+{
+  std::vector<ESRBlock> ring_;
+  std::atomic<std::size_t> head_; // next to pop.  written by consumer
+  std::atomic<std::size_t> tail_; // next to push. written by producer
+  std::atomic<std::size_t> dropped_;
+
+public:
+  ESRStream(std::size_t capacity = 64);
+  ESRStream(const ESRStream&) = delete;
+  ESRStream& operator=(const ESRStream&) = delete;
+
+  bool Push(ESRBlock&& block);
+  bool Pop(ESRBlock& block);
+
+  std::size_t GetCapacity() const;
+  std::size_t GetDropped() const;
+  bool IsEmpty() const;
+};
+
+#endif
@@ -0,0 +1,171 @@
+#include "ESRTextParser.hh"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring> // memchr
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+
+unsigned int ESRTextParser::nthreads = 0;
+std::size_t ESRTextParser::min_chunk_lines = 8192;
+
+namespace
+{
+  inline bool is_blank(char c) {return c == ' ' or c == '\t' or c == '\r';}
+
+  inline const char* end_of_line(const char* p, const char* end)
+  {
+    auto q = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    return q? q : end;
+  }
+}
+
+/**
+   find the next non-blank line from begin.
+
+   @return head of the line (end if not found). line_end points '\\n' or end.
+ */
+const char* ESRTextParser::FindLine(const char* begin, const char* end, const char*& line_end)
+{
+  auto p = begin;
+  while(p < end)
+    {
+      line_end = end_of_line(p, end);
+      for(auto q = p; q < line_end; ++q)
+        {
+          if(not is_blank(*q))
+            return p;
+        }
+      p = line_end + 1;
+    }
+  line_end = end;
+  return end;
+}
+
+/**
+   skip nlines non-blank lines.
+
+   @return head of the line just after them.
+ */
+const char* ESRTextParser::SkipLines(const char* begin, const char* end, std::size_t nlines)
+{
+  auto p = begin;
+  const char* line_end = end;
+  for(auto i = 0ul; i < nlines and p < end; ++i)
+    {
+      p = FindLine(p, end, line_end);
+      p = (line_end < end)? line_end + 1 : end;
+    }
+  return p;
+}
+
+/**
+   split nlines records into nchunks pieces of (almost) the same number of lines.
+   Only line boundaries are searched (memchr): no number is parsed here.
+
+   @return nchunks + 1 pointers. chunk i is [ret[i], ret[i+1]) and its first
+   record index is i * nlines / nchunks.
+ */
+std::vector<const char*> ESRTextParser::SplitLines(const char* begin, const char* end,
+                                                   std::size_t nlines, std::size_t nchunks)
+{
+  std::vector<const char*> bounds;
+  bounds.reserve(nchunks + 1);
+
+  auto p = begin;
+  const char* line_end = end;
+  std::size_t iline = 0;
+  for(auto ichunk = 0ul; ichunk < nchunks; ++ichunk)
+    {
+      bounds.push_back(p);
+      auto next = (ichunk + 1) * nlines / nchunks;
+      for(; iline < next; ++iline)
+        {
+          p = FindLine(p, end, line_end);
+          if(p == end)
+            throw std::invalid_argument("unexpected end of data after "
+                                        + std::to_string(iline) + " lines");
+          p = (line_end < end)? line_end + 1 : end;
+        }
+    }
+  bounds.push_back(p);
+
+  return bounds;
+}
+
+/**
+   parse one chunk. Record i in the chunk is stored at columns[c][offset + i].
+   nullptr in columns means the column is read and dropped.
+ */
+void ESRTextParser::ParseChunk(const char* begin, const char* end, std::size_t offset,
+                               const std::vector<double*>& columns)
+{
+  auto p = begin;
+  const char* line_end = end;
+  auto index = offset;
+  while(true)
+    {
+      p = FindLine(p, end, line_end);
+      if(p == end)
+        break;
+
+      for(auto col : columns)
+        {
+          while(p < line_end and is_blank(*p))
+            ++p;
+          if(p < line_end and *p == '+') // from_chars does not accept '+'
+            ++p;
+
+          double val = 0;
+          auto res = std::from_chars(p, line_end, val);
+          if(res.ec == std::errc::invalid_argument)
+            throw std::invalid_argument("fail to convert \"" + std::string(p, line_end) + "\"");
+          if(res.ec == std::errc::result_out_of_range)
+            throw std::out_of_range("fail to convert \"" + std::string(p, line_end) + "\"");
+
+          if(col)
+            col[index] = val;
+          p = res.ptr;
+        }
+
+      ++index;
+      p = (line_end < end)? line_end + 1 : end;
+    }
+}
+
+/**
+   parse nlines records from begin on several threads.
+
+   @param columns output arrays, one per column, holding nlines elements.
+   @return head of the line following the last record.
+ */
+const char* ESRTextParser::Parse(const char* begin, const char* end, std::size_t nlines,
+                                 const std::vector<double*>& columns)
+{
+  std::size_t nth = nthreads? nthreads : std::thread::hardware_concurrency();
+  if(nth == 0)
+    nth = 1;
+  auto nchunks = std::max<std::size_t>(1, std::min(nth, nlines / std::max<std::size_t>(1, min_chunk_lines)));
+
+  auto bounds = SplitLines(begin, end, nlines, nchunks);
+
+  // the first chunk is parsed on this thread
+  std::vector<std::future<void> > futures;
+  futures.reserve(nchunks - 1);
+  for(auto ichunk = 1ul; ichunk < nchunks; ++ichunk)
+    {
+      futures.push_back(std::async(std::launch::async, &ESRTextParser::ParseChunk,
+                                   bounds[ichunk], bounds[ichunk + 1],
+                                   ichunk * nlines / nchunks, std::cref(columns)));
+    }
+  ParseChunk(bounds[0], bounds[1], 0, columns);
+
+  // exception thrown in the thread is re-thrown here.
+  for(auto& f : futures)
+    f.get();
+
+  return bounds.back();
+}
@@ -0,0 +1,46 @@
+#ifndef ESRTextParser_hh
+#define ESRTextParser_hh
+
+#include <cstddef>
+#include <vector>
+
+/**
+   parser of numerical data part of text files ("Data Head" and wave format).
+
+   Whole data section is given as one buffer (e.g. memory mapped file).
+   The buffer is split into chunks at line boundaries, and every chunk is
+   parsed by std::from_chars on its own thread into preallocated arrays.
+
+   Each non-blank line is one record holding ncol numbers.
+   Blank lines are skipped and not counted.
+
+   \code{.cpp}
+   std::vector<double> x(n), y(n);
+   auto next = ESRTextParser::Parse(p, end, n, {x.data(), y.data()});
+   \endcode
+
+   Conversion error throws std::invalid_argument (or std::out_of_range)
+   like std::stod.
+ */
+class ESRTextParser
+{
+public:
+  /** number of threads. 0: std::thread::hardware_concurrency() */
+  static unsigned int nthreads;
+  /** records less than this are parsed by one thread */
+  static std::size_t min_chunk_lines;
+
+  static const char* SkipLines(const char* begin, const char* end, std::size_t nlines);
+  static const char* FindLine(const char* begin, const char* end, const char*& line_end);
+
+  static std::vector<const char*> SplitLines(const char* begin, const char* end,
+                                             std::size_t nlines, std::size_t nchunks);
+
+  static const char* Parse(const char* begin, const char* end, std::size_t nlines,
+                           const std::vector<double*>& columns);
+
+  static void ParseChunk(const char* begin, const char* end, std::size_t offset,
+                         const std::vector<double*>& columns);
+};
+
+#endif
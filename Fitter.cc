@@ -48,12 +48,18 @@ Int_t Fitter::Eval( Int_t npar, Double_t* grad,
   
   fval = 0.0;
   
+  // all points at once: the density is evaluated once per parameter set
+  vector< double > ts, vraws;
   for( int i = 0; i < g_->GetN(); i++ ){
     double t, vraw;
     g_->GetPoint( i, t, vraw );
     if( ( tmin_ < tmax_ ) && ( t < tmin_ || t > tmax_ ) ) continue;
-    fval += pow( vraw - app_->evalI( t ), 2.0 );
+    ts.push_back( t );
+    vraws.push_back( vraw );
   }
+  
+  vector< double > vs = app_->evalI( ts );
+  for( int i = 0; i < ts.size(); i++ ) fval += pow( vraws[ i ] - vs[ i ], 2.0 );
 }
 
 void Fitter::fit( TGraph *g ){
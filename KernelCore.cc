@@ -12,19 +12,22 @@ KernelCore::KernelCore() {
 KernelCore::~KernelCore() {
 }
 
-double KernelCore::f( const double& x ){
-  // x must be -1 < x < 2
-  if( x < -1.0 || x > 2.0 ) return 0.0;
-  double v = x + 1.0;
-  return ( v > 0.0 ? 1.0 / sqrt( v/3.0 ) : 0.0 );
-}
-
-double KernelCore::ftilde( const double& x ){
-  return this->f( x ) + this->f( - x );
+double KernelCore::operator()( const double& r, const double& t ){
+  return this->ftilde( - t * ( r * r * r ) / 1.395 );
 }
 
-double KernelCore::operator()( const double& r, const double& t ){
-  return this->ftilde( - t * pow( r, 3.0 ) / 1.395 );
+/*
+  ftilde(y) = sqrt( 3 / (1+y) ) (y <= 2) + sqrt( 3 / (1-y) ) (y < 1), y = |x|:
+  both terms are calculated and selected, not branched, so that the loop
+  is vectorized.
+*/
+void KernelCore::addFtilde( const double& c, const double* a, double* out, const size_t& n ){
+  for( size_t i = 0; i < n; i++ ){
+    double y = fabs( c * a[ i ] );
+    double fp = sqrt( 3.0 / ( 1.0 + y ) );
+    double fm = sqrt( 3.0 / fabs( 1.0 - y ) );
+    out[ i ] += ( y <= 2.0 ? fp : 0.0 ) + ( y < 1.0 ? fm : 0.0 );
+  }
 }
 
 string KernelCore::text(){
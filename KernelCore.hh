@@ -2,6 +2,8 @@
 #define _KernelCore_hh_
 
 #include <string>
+#include <cmath>
+#include <cstddef>
 #include <TObject.h>
 
 class KernelCore : public TObject {
@@ -17,6 +19,9 @@ public:
   // f(x) + f(-x)
   double ftilde( const double& x );
 
+  // out[i] += ftilde( c * a[i] ) for i < n
+  void addFtilde( const double& c, const double* a, double* out, const std::size_t& n );
+
   std::string text();
 
   double operator()( const double& r, const double& t );
@@ -25,4 +30,16 @@ private:
   ClassDef( KernelCore, 1.0 );
 };
 
+// inline: called for every quadrature node and ESR line
+inline double KernelCore::f( const double& x ){
+  // x must be -1 < x < 2
+  if( x < -1.0 || x > 2.0 ) return 0.0;
+  double v = x + 1.0;
+  return ( v > 0.0 ? 1.0 / std::sqrt( v/3.0 ) : 0.0 );
+}
+
+inline double KernelCore::ftilde( const double& x ){
+  return this->f( x ) + this->f( - x );
+}
+
 #endif // _KernelCore_hh_
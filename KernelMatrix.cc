@@ -0,0 +1,166 @@
+#include "KernelMatrix.hh"
+#include "DipoleKernel.hh"
+#include "Density.hh"
+
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+  const double sqrt3 = 1.7320508075688772;
+
+  /*
+    primitives of ftilde(y) and y ftilde(y) in y = |x| >= 0,
+    ftilde(y) = sqrt(3) [ (1+y)^{-1/2} (y <= 2) + (1-y)^{-1/2} (y < 1) ],
+    constant beyond the cut off.
+  */
+  void primitives( const double& y, double& q0, double& q1 ){
+    double p = sqrt( 1.0 + min( y, 2.0 ) );
+    double m = sqrt( 1.0 - min( y, 1.0 ) );
+    q0 = sqrt3 * 2.0 * ( p - m );
+    q1 = sqrt3 * ( 2.0 / 3.0 * ( p * p * p + m * m * m ) - 2.0 * ( p + m ) );
+  }
+
+  // \int_{a0}^{a1} ( a - a0 ) a^n da, from a0^k and a1^k ( k = 0 ... n + 2 )
+  double moment( const double* p0, const double* p1, const int& n ){
+    return
+      ( p1[ n + 2 ] - p0[ n + 2 ] ) / ( n + 2 ) -
+      p0[ 1 ] * ( p1[ n + 1 ] - p0[ n + 1 ] ) / ( n + 1 );
+  }
+
+  // below this y, ftilde(y) = 2 sqrt(3) ( 1 + 3/8 y^2 + 35/128 y^4 ) is used:
+  // differences of the primitives lose digits
+  const double ysmall = 0.05;
+}
+
+KernelMatrix::KernelMatrix() :
+  k_( NULL ), rho_( NULL ),
+  lower_( 0.0 ), upper_( 0.0 ), nNode_( 1000 ),
+  a_( 0 ), w_( 0 )
+{
+}
+
+KernelMatrix::KernelMatrix( DipoleKernel* k, Density* rho ) :
+  k_( k ), rho_( rho ),
+  lower_( 0.0 ), upper_( 0.0 ), nNode_( 1000 ),
+  a_( 0 ), w_( 0 )
+{
+}
+
+KernelMatrix::~KernelMatrix() {
+}
+
+/*
+  r nodes: uniform in each of [ lower, mean - sigma-, mean, mean + sigma+, upper ],
+  about ( upper - lower ) / nNode apart. Density and weight are evaluated here.
+*/
+void KernelMatrix::nodes(){
+  vector< double > edges( 1, lower_ );
+  double m = rho_->mean();
+  double e[ 3 ] = { m - rho_->asigma( false ), m, m + rho_->asigma( true ) };
+  for( int i = 0; i < 3; i++ ) if( e[ i ] > lower_ && e[ i ] < upper_ ) edges.push_back( e[ i ] );
+  edges.push_back( upper_ );
+  sort( edges.begin(), edges.end() );
+
+  double h = ( upper_ - lower_ ) / nNode_;
+  vector< double > r;
+  for( int i = 0; i + 1 < edges.size(); i++ ){
+    double width = edges[ i + 1 ] - edges[ i ];
+    int n = max( 1, int( ceil( width / h ) ) );
+    for( int j = 0; j < n; j++ ) r.push_back( edges[ i ] + width * j / n );
+  }
+  r.push_back( upper_ );
+
+  a_.resize( r.size() );
+  w_.resize( r.size() );
+  rho_->eval( r.data(), w_.data(), r.size() );
+  for( int j = 0; j < r.size(); j++ ){
+    a_[ j ] = r[ j ] * r[ j ] * r[ j ];
+    w_[ j ] = r[ j ] > 0.0 ? k_->weight( r[ j ] ) * w_[ j ] / ( 3.0 * r[ j ] * r[ j ] ) : 0.0;
+  }
+}
+
+/*
+  \sum_j M_{kj} w_j for one t. On [a0,a1] with W linear,
+  \int W ftilde da = w0 ( A - C / h ) + w1 C / h,
+  A = \int ftilde da, C = \int ( a - a0 ) ftilde da, h = a1 - a0.
+*/
+double KernelMatrix::row( const double& t ){
+  vector< double > lines = k_->lines();
+  if( lines.size() == 0 ) lines.push_back( 0.0 );
+  int nl = lines.size();
+
+  vector< double > s( nl ), q0( nl ), q1( nl );
+  for( int i = 0; i < nl; i++ ){
+    s[ i ] = fabs( t - lines[ i ] ) / 1.395;
+    primitives( s[ i ] * a_[ 0 ], q0[ i ], q1[ i ] );
+  }
+
+  // the kernel is zero beyond rmax( t )
+  double rmax = k_->rmax( t );
+  double amax = rmax * rmax * rmax;
+
+  double sum = 0.0;
+  for( int j = 0; j + 1 < a_.size() && a_[ j ] < amax; j++ ){
+    double a0 = a_[ j ], a1 = a_[ j + 1 ], h = a1 - a0;
+    double A = 0.0, C = 0.0;
+    for( int i = 0; i < nl; i++ ){
+      double y1 = s[ i ] * a1;
+      double p0, p1;
+      primitives( y1, p0, p1 );
+      if( y1 < ysmall ){
+	double s2 = s[ i ] * s[ i ];
+	double c2 = 3.0 / 8.0 * s2, c4 = 35.0 / 128.0 * s2 * s2;
+	double pw0[ 7 ] = { 1.0 }, pw1[ 7 ] = { 1.0 };
+	for( int n = 1; n < 7; n++ ){
+	  pw0[ n ] = pw0[ n - 1 ] * a0;
+	  pw1[ n ] = pw1[ n - 1 ] * a1;
+	}
+	A += 2.0 * sqrt3 *
+	  ( h + c2 * ( pw1[ 3 ] - pw0[ 3 ] ) / 3.0 + c4 * ( pw1[ 5 ] - pw0[ 5 ] ) / 5.0 );
+	C += 2.0 * sqrt3 *
+	  ( 0.5 * h * h + c2 * moment( pw0, pw1, 2 ) + c4 * moment( pw0, pw1, 4 ) );
+      } else {
+	double d0 = p0 - q0[ i ];
+	A += d0 / s[ i ];
+	C += ( p1 - q1[ i ] - s[ i ] * a0 * d0 ) / ( s[ i ] * s[ i ] );
+      }
+      q0[ i ] = p0;
+      q1[ i ] = p1;
+    }
+    sum += w_[ j ] * ( A - C / h ) + w_[ j + 1 ] * C / h;
+  }
+  return sum;
+}
+
+vector< double > KernelMatrix::operator()( const vector< double >& t ){
+  vector< double > v( t.size(), 0.0 );
+  if( k_ == NULL || rho_ == NULL || ! ( upper_ > lower_ ) || t.size() == 0 ) return v;
+
+  this->nodes();
+
+  if( k_->lines().size() > 1 ){
+    for( int k = 0; k < t.size(); k++ ) v[ k ] = this->row( t[ k ] );
+    return v;
+  }
+
+  // one line at H: I(H + u) = I(H - u), each |u| once
+  double H = k_->lines().size() == 1 ? k_->lines()[ 0 ] : 0.0;
+  vector< pair< double, int > > u( t.size() );
+  for( int k = 0; k < t.size(); k++ ) u[ k ] = make_pair( fabs( t[ k ] - H ), k );
+  sort( u.begin(), u.end() );
+
+  double ulast = -1.0, vlast = 0.0;
+  for( int k = 0; k < u.size(); k++ ){
+    if( ulast < 0.0 || u[ k ].first - ulast > 1.0E-9 ){
+      ulast = u[ k ].first;
+      vlast = this->row( H + ulast );
+    }
+    v[ u[ k ].second ] = vlast;
+  }
+  return v;
+}
+
+ClassImp( KernelMatrix );
@@ -0,0 +1,71 @@
+#ifndef _KernelMatrix_hh_
+#define _KernelMatrix_hh_
+
+#include <TObject.h>
+#include <vector>
+
+class DipoleKernel;
+class Density;
+
+/*
+  Integration of the dipole kernel with the density for many t at once:
+
+  I(t_k) = \int_{lower}^{upper} K(r,t_k) rho(r) dr = \sum_j M_{kj} w_j
+
+  on a fixed set of r nodes. In a = r^3, the kernel depends on a only
+  through x = (t - H_i) a / 1.395, and
+
+  I(t) = \int W(a) \sum_i ftilde( x ) da,  W(a) = weight(r) rho(r) / ( 3 r^2 )
+
+  W(a) is linear between nodes (w_j = W(a_j)), and ftilde is integrated
+  analytically against it (product integration): the singularity at
+  |x| = 1 and the cut off at |x| = 2 are exact for any t, and the density
+  and the weight are evaluated once for all t.
+
+  With one ESR line, I(H + u) = I(H - u) (ftilde is even): each |u| is
+  calculated once. Nodes beyond DipoleKernel::rmax( t ) are skipped.
+
+  MyApplication::kernelMatrix( true ) selects this integration for
+  evalI(), drawI(), Fitter and LineShape.
+*/
+class KernelMatrix : public TObject {
+public:
+
+  KernelMatrix();
+  KernelMatrix( DipoleKernel* k, Density* rho );
+  virtual ~KernelMatrix();
+
+  void kernel( DipoleKernel* k ) { k_ = k; }
+  void density( Density* rho ) { rho_ = rho; }
+  DipoleKernel* kernel() { return k_; }
+  Density* density() { return rho_; }
+
+  void upper( const double& v ) { upper_ = v; }
+  void lower( const double& v ) { lower_ = v; }
+  double upper() const { return upper_; }
+  double lower() const { return lower_; }
+
+  // number of r intervals in [ lower, upper ]
+  void nNode( const int& n ) { if( n > 0 ) nNode_ = n; }
+  int nNode() const { return nNode_; }
+
+  // I(t) for all t, with the density of the moment
+  std::vector< double > operator()( const std::vector< double >& t );
+
+private:
+  DipoleKernel* k_;  //!
+  Density* rho_;     //!
+  double lower_;
+  double upper_;
+  int nNode_;
+
+  std::vector< double > a_;  //! nodes in a = r^3
+  std::vector< double > w_;  //! W(a) on the nodes
+
+  void nodes();
+  double row( const double& t );
+
+  ClassDef( KernelMatrix, 1.0 );
+};
+
+#endif // _KernelMatrix_hh_
@@ -0,0 +1,172 @@
+#include "KernelQuadrature.hh"
+#include "DipoleKernel.hh"
+#include "Density.hh"
+
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+KernelQuadrature::KernelQuadrature() :
+  k_( NULL ), rho_( NULL ),
+  lower_( 0.0 ), upper_( 0.0 ), precision_( 1.0E-4 ), maxDepth_( 16 ), nEval_( 0 ),
+  nodes_( 0 ), weights_( 0 ), sin2_( 0 ), cos2_( 0 ),
+  r_( 0 ), core_( 0 ), rho_r_( 0 )
+{
+  this->nNode( 10 );
+}
+
+KernelQuadrature::KernelQuadrature( DipoleKernel* k, Density* rho ) :
+  k_( k ), rho_( rho ),
+  lower_( 0.0 ), upper_( 0.0 ), precision_( 1.0E-4 ), maxDepth_( 16 ), nEval_( 0 ),
+  nodes_( 0 ), weights_( 0 ), sin2_( 0 ), cos2_( 0 ),
+  r_( 0 ), core_( 0 ), rho_r_( 0 )
+{
+  this->nNode( 10 );
+}
+
+KernelQuadrature::~KernelQuadrature() {
+}
+
+/*
+  Gauss-Legendre nodes and weights on [0,1]: roots of P_n by Newton's method.
+*/
+void KernelQuadrature::nNode( const int& n ){
+  if( n < 1 ) return;
+  nodes_.resize( n );
+  weights_.resize( n );
+  for( int i = 0; i < ( n + 1 ) / 2; i++ ){
+    double z = cos( M_PI * ( i + 0.75 ) / ( n + 0.5 ) );
+    double dp = 0.0;
+    for( int iter = 0; iter < 100; iter++ ){
+      double p0 = 1.0, p1 = 0.0;
+      for( int j = 1; j <= n; j++ ){
+	double p2 = p1;
+	p1 = p0;
+	p0 = ( ( 2.0 * j - 1.0 ) * z * p1 - ( j - 1.0 ) * p2 ) / j;
+      }
+      dp = n * ( z * p0 - p1 ) / ( z * z - 1.0 );
+      double dz = p0 / dp;
+      z -= dz;
+      if( fabs( dz ) < 1.0E-15 ) break;
+    }
+    double w = 2.0 / ( ( 1.0 - z * z ) * dp * dp );
+    nodes_[ i ]         = 0.5 * ( 1.0 - z );
+    nodes_[ n - 1 - i ] = 0.5 * ( 1.0 + z );
+    weights_[ i ] = weights_[ n - 1 - i ] = 0.5 * w;
+  }
+
+  // th = pi * node: sin^2(th/2), cos^2(th/2), and sin(th) in the weights
+  sin2_.resize( n );
+  cos2_.resize( n );
+  for( int i = 0; i < n; i++ ){
+    double th = M_PI * nodes_[ i ];
+    double s = sin( 0.5 * th );
+    double c = cos( 0.5 * th );
+    sin2_[ i ] = s * s;
+    cos2_[ i ] = c * c;
+    weights_[ i ] *= sin( th );
+  }
+  r_.resize( n );
+  core_.resize( n );
+  rho_r_.resize( n );
+}
+
+vector< double > KernelQuadrature::breakpoints( const double& t ){
+  // the kernel is zero beyond rmax( t )
+  double upper = min( upper_, k_->rmax( t ) );
+  if( ! ( upper > lower_ ) ) return vector< double >( 0 );
+  
+  vector< double > points( 1, lower_ );
+
+  // edges of the kernel: |x| = 1 and 2
+  vector< double > lines = k_->lines();
+  if( lines.size() == 0 ) lines.push_back( 0.0 );
+  for( int i = 0; i < lines.size(); i++ ){
+    double u = fabs( t - lines[ i ] );
+    if( u == 0.0 ) continue;
+    points.push_back( cbrt( 1.395 / u ) );
+    points.push_back( cbrt( 2.0 * 1.395 / u ) );
+  }
+
+  // shape of the density
+  if( rho_ ){
+    points.push_back( rho_->mean() );
+    points.push_back( rho_->mean() - rho_->asigma( false ) );
+    points.push_back( rho_->mean() + rho_->asigma( true ) );
+  }
+
+  points.push_back( upper );
+  sort( points.begin(), points.end() );
+
+  vector< double > inside;
+  for( int i = 0; i < points.size(); i++ ){
+    if( points[ i ] < lower_ || points[ i ] > upper ) continue;
+    if( inside.size() > 0 && points[ i ] == inside.back() ) continue;
+    inside.push_back( points[ i ] );
+  }
+  return inside;
+}
+
+/*
+  one rule on [a,b] with r = a + (b-a)(1-cos(th))/2, th in [0,pi].
+  r - a and b - r are calculated as sin^2, cos^2 not to lose digits
+  near singular ends. Kernel and density are evaluated for all nodes
+  at once.
+*/
+double KernelQuadrature::piece( const double& a, const double& b, const double& t ){
+  int n = nodes_.size();
+  if( n == 0 ) return 0.0;
+  double h = b - a;
+  for( int i = 0; i < n; i++ ){
+    r_[ i ] = nodes_[ i ] < 0.5 ? a + h * sin2_[ i ] : b - h * cos2_[ i ];
+  }
+  k_->core( r_.data(), t, core_.data(), n );
+  rho_->eval( r_.data(), rho_r_.data(), n );
+  nEval_ += n;
+
+  double sum = 0.0;
+  for( int i = 0; i < n; i++ ){
+    if( r_[ i ] > 0.0 ) sum += weights_[ i ] * k_->weight( r_[ i ] ) * core_[ i ] * rho_r_[ i ];
+  }
+  return 0.5 * M_PI * h * sum;
+}
+
+double KernelQuadrature::adaptive( const double& a, const double& b, const double& t,
+				   const double& whole, const double& tol, const int& depth ){
+  double m = 0.5 * ( a + b );
+  double left  = this->piece( a, m, t );
+  double right = this->piece( m, b, t );
+  double both  = left + right;
+  // agreed, or below rounding
+  if( depth >= maxDepth_ || fabs( both - whole ) <= max( tol, 1.0E-14 * fabs( both ) ) )
+    return both;
+  return
+    this->adaptive( a, m, t, left,  0.5 * tol, depth + 1 ) +
+    this->adaptive( m, b, t, right, 0.5 * tol, depth + 1 );
+}
+
+double KernelQuadrature::operator()( const double& t ){
+  if( k_ == NULL || rho_ == NULL || ! ( upper_ > lower_ ) ) return 0.0;
+
+  vector< double > points = this->breakpoints( t );
+  if( points.size() < 2 ) return 0.0;
+  vector< double > wholes( points.size() - 1 );
+  double total = 0.0;
+  for( int i = 0; i + 1 < points.size(); i++ ){
+    wholes[ i ] = this->piece( points[ i ], points[ i + 1 ], t );
+    total += wholes[ i ];
+  }
+  if( total == 0.0 ) return 0.0;
+
+  // tolerance is shared by pieces in proportion to their width
+  double tol = precision_ * fabs( total ) / ( points.back() - points.front() );
+  double sum = 0.0;
+  for( int i = 0; i + 1 < points.size(); i++ ){
+    double w = points[ i + 1 ] - points[ i ];
+    sum += this->adaptive( points[ i ], points[ i + 1 ], t, wholes[ i ], tol * w, 0 );
+  }
+  return sum;
+}
+
+ClassImp( KernelQuadrature );
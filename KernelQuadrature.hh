@@ -0,0 +1,97 @@
+#ifndef _KernelQuadrature_hh_
+#define _KernelQuadrature_hh_
+
+#include <TObject.h>
+#include <vector>
+
+class DipoleKernel;
+class Density;
+
+/*
+  Integration of the dipole kernel with the density:
+
+  I(t) = \int_{lower}^{upper} K(r,t) rho(r) dr
+
+  which knows where the kernel is not smooth. For each ESR line H_i,
+  x = (t - H_i) r^3 / 1.395 and the kernel behaves as
+
+    |x| = 1 : inverse square root singularity, at r = (1.395/|t-H_i|)^{1/3}
+    |x| = 2 : cut off (jump to zero),          at r = (2.79/|t-H_i|)^{1/3}
+
+  The range is split at these points (and at mean, mean +- sigma of
+  the density). On each piece [a,b], r = a + (b-a)(1-cos(th))/2
+  cancels inverse square root singularities at both ends (as
+  Gauss-Jacobi with alpha = beta = -1/2), and Gauss-Legendre rule
+  of nNode() points in th is applied. Pieces are bisected until two
+  halves agree with the whole within the required precision.
+
+  The grid integration of Transform::RTransform needs high settings
+  ( precision( 0.0001 ), nGrid( 10 ), nLeg( 7, 8 ) ) for the same edge.
+
+  MyApplication::kernelQuadrature( true ) selects this integration
+  for evalI() and LineShape.
+*/
+class KernelQuadrature : public TObject {
+public:
+
+  KernelQuadrature();
+  KernelQuadrature( DipoleKernel* k, Density* rho );
+  virtual ~KernelQuadrature();
+
+  void kernel( DipoleKernel* k ) { k_ = k; }
+  void density( Density* rho ) { rho_ = rho; }
+  DipoleKernel* kernel() { return k_; }
+  Density* density() { return rho_; }
+
+  void upper( const double& v ) { upper_ = v; }
+  void lower( const double& v ) { lower_ = v; }
+  double upper() const { return upper_; }
+  double lower() const { return lower_; }
+
+  // relative precision of I(t)
+  void precision( const double& p ) { precision_ = p; }
+  double precision() const { return precision_; }
+
+  // number of Gauss-Legendre points on a piece
+  void nNode( const int& n );
+  int nNode() const { return nodes_.size(); }
+
+  // maximum number of bisection of a piece
+  void maxDepth( const int& n ) { maxDepth_ = n; }
+  int maxDepth() const { return maxDepth_; }
+
+  // points splitting [ lower, min( upper, rmax( t ) ) ] at t, in ascending order
+  // (both ends included). Empty if the kernel is zero in the range.
+  std::vector< double > breakpoints( const double& t );
+
+  double operator()( const double& t );
+
+  // number of evaluation of K(r,t) rho(r) since the last reset
+  long nEval() const { return nEval_; }
+  void resetNEval() { nEval_ = 0; }
+
+private:
+  DipoleKernel* k_;  //!
+  Density* rho_;     //!
+  double lower_;
+  double upper_;
+  double precision_;
+  int maxDepth_;
+  long nEval_;       //!
+
+  std::vector< double > nodes_;    //! Gauss-Legendre on [0,1]
+  std::vector< double > weights_;  //! times sin( pi * node )
+  std::vector< double > sin2_;     //! sin^2( pi * node / 2 )
+  std::vector< double > cos2_;     //! cos^2( pi * node / 2 )
+  std::vector< double > r_;        //! work arrays of a piece
+  std::vector< double > core_;     //!
+  std::vector< double > rho_r_;    //!
+
+  double piece( const double& a, const double& b, const double& t );
+  double adaptive( const double& a, const double& b, const double& t,
+		   const double& whole, const double& tol, const int& depth );
+
+  ClassDef( KernelQuadrature, 1.0 );
+};
+
+#endif // _KernelQuadrature_hh_
@@ -1,7 +1,12 @@
 #include "LineShape.hh"
 #include "Density.hh"
+#include "DipoleKernel.hh"
+#include "KernelQuadrature.hh"
+#include "KernelMatrix.hh"
 #include <Tranform/RTransform.hh>
 
+#include <algorithm>
+
 #include "AGaus.hh"
 
 double LineShape::operator()( double* x, double *p ){
@@ -15,7 +20,24 @@ double LineShape::operator()( double* x, double *p ){
     ag->asigma( false, p[ 3 ] );
   }
   
-  rT_->upper( rho_->upper() );
+  if( kq_ ){
+    kq_->upper( rho_->upper() );
+    kq_->lower( rho_->lower() );
+    return (*kq_)( x[ 0 ] );
+  }
+  
+  if( km_ ){
+    km_->upper( rho_->upper() );
+    km_->lower( rho_->lower() );
+    return (*km_)( std::vector< double >( 1, x[ 0 ] ) )[ 0 ];
+  }
+  
+  // the kernel is zero beyond rmax: integrate only where it is not
+  double upper = rho_->upper();
+  if( k_ ) upper = std::min( upper, k_->rmax( x[ 0 ] ) );
+  if( upper <= rho_->lower() ) return 0.0;
+  
+  rT_->upper( upper );
   rT_->lower( rho_->lower() );
 
   return (*rT_)( x[ 0 ] );
@@ -6,14 +6,18 @@
 namespace Transform {
   class RTransform;
 }
-//class DipoleKernel;
+class DipoleKernel;
 class Density;
+class KernelQuadrature;
+class KernelMatrix;
 
 class LineShape : public TObject {
 public:  
   double operator()( double *x, double *p );
   Transform::RTransform *rT_;
-  //  DipoleKernel* k_;
+  KernelQuadrature *kq_ = NULL; // used instead of rT_ if not NULL
+  KernelMatrix *km_ = NULL;     // used instead of rT_ if not NULL (and kq_ is NULL)
+  DipoleKernel *k_ = NULL;      // support of the kernel, if not NULL
   Density *rho_;
   double base_;
   ClassDef( LineShape, 1.0 );
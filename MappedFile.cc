@@ -0,0 +1,63 @@
+#include "MappedFile.hh"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "TError.h"
+
+/**
+   map the file given by path.
+   Error message is printed and IsOpen() returns false on failure.
+ */
+MappedFile::MappedFile(const std::string& path) :
+  path_(path), data_(nullptr), size_(0), mtime_(0)
+{
+  auto fd = open(path_.c_str(), O_RDONLY);
+  if(fd < 0)
+    {
+      Error("MappedFile::MappedFile", "fail to open %s", path_.c_str());
+      return;
+    }
+
+  struct stat st;
+  if(fstat(fd, &st) != 0 or st.st_size <= 0)
+    {
+      Error("MappedFile::MappedFile", "fail to stat (or empty) %s", path_.c_str());
+      close(fd);
+      return;
+    }
+
+  auto p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd); // mapping keeps the file alive.
+
+  if(p == MAP_FAILED)
+    {
+      Error("MappedFile::MappedFile", "mmap failed for %s", path_.c_str());
+      return;
+    }
+
+  data_ = static_cast<const char*>(p);
+  size_ = st.st_size;
+  mtime_ = st.st_mtime;
+}
+
+MappedFile::~MappedFile()
+{
+  if(data_)
+    munmap(const_cast<char*>(data_), size_);
+}
+
+bool MappedFile::IsOpen() const {return data_ != nullptr;}
+
+std::string MappedFile::GetPath() const {return path_;}
+
+/**
+   pointer to the head of the file. Valid during the life time of this object.
+ */
+const char* MappedFile::GetData() const {return data_;}
+
+std::size_t MappedFile::GetSize() const {return size_;}
+
+std::time_t MappedFile::GetModificationTime() const {return mtime_;}
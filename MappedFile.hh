@@ -0,0 +1,41 @@
+#ifndef MappedFile_hh
+#define MappedFile_hh
+
+#include <string>
+#include <cstddef>
+#include <ctime>
+
+/**
+   read-only memory mapped file (POSIX mmap).
+
+   The whole file is mapped on construction and unmapped by destructor.
+   Copy is forbidden; share it by std::shared_ptr when several objects
+   refer to the same mapping.
+
+   \code{.cpp}
+   MappedFile mf{"data.bin"};
+   if(mf.IsOpen())
+     auto p = mf.GetData(); // const char*
+   \endcode
+ */
+class MappedFile
+{
+  std::string path_;
+  const char* data_;
+  std::size_t size_;
+  std::time_t mtime_;
+
+public:
+  MappedFile(const std::string& path);
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile();
+
+  bool IsOpen() const;
+  std::string GetPath() const;
+  const char* GetData() const;
+  std::size_t GetSize() const;
+  std::time_t GetModificationTime() const;
+};
+
+#endif
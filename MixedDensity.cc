@@ -1,9 +1,10 @@
 #include "MixedDensity.hh"
+#include "Density.hh"
 
 using namespace std;
 
 MixedDensity::MixedDensity() :
-  vector< Transform::RealFunction* >( 0 ) {
+  vector< Transform::RealFunction* >( 0 ), work_( 0 ) {
 }
 
 MixedDensity::~MixedDensity(){
@@ -17,4 +18,20 @@ double MixedDensity::operator()( const double& x ){
   return v;
 }
 
+void MixedDensity::eval( const double* x, double* out, const size_t& n ){
+  if( n == 0 ) return;
+  for( size_t j = 0; j < n; j++ ) out[ j ] = 0.0;
+  work_.resize( n );
+  double *v = work_.data();
+  for( int i = 0; i < this->size(); i++ ){
+    Density *rho = dynamic_cast< Density* >( (*this)[ i ] );
+    if( rho ) {
+      rho->eval( x, v, n );
+    } else {
+      for( size_t j = 0; j < n; j++ ) v[ j ] = (*( (*this)[ i ] ) )( x[ j ] );
+    }
+    for( size_t j = 0; j < n; j++ ) out[ j ] += v[ j ];
+  }
+}
+
 ClassImp( MixedDensity );
@@ -4,6 +4,7 @@
 #include <Tranform/RealFunction.hh>
 #include <TObject.h>
 #include <vector>
+#include <cstddef>
 
 class MixedDensity : public Transform::RealFunction,
 		     public TObject,
@@ -13,7 +14,11 @@ public:
   MixedDensity();
   virtual ~MixedDensity();
   virtual double operator()( const double& x );
+  
+  // out[i] = (*this)( x[i] ): Density components are evaluated with Density::eval
+  virtual void eval( const double* x, double* out, const std::size_t& n );
 private:
+  std::vector< double > work_; //! values of a component in eval()
 
   ClassDef( MixedDensity, 1.0 );
 };
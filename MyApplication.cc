@@ -1,5 +1,7 @@
 #include "MyApplication.hh"
 #include "DipoleKernel.hh"
+#include "KernelQuadrature.hh"
+#include "KernelMatrix.hh"
 #include "AGaus.hh"
 #include "ESR.hh"
 #include "LineShape.hh"
@@ -9,6 +11,7 @@
 #include <Tranform/GridIntegration.hh>
 
 #include <iostream>
+#include <cmath>
 #include <iomanip>
 #include <sstream>
 
@@ -32,6 +35,10 @@ MyApplication::MyApplication( int argc, char* argv[] ) :
   k_( NULL ),
   rho_( NULL ),
   rT_( NULL ),
+  kq_( NULL ),
+  km_( NULL ),
+  useKq_( false ),
+  useKm_( false ),
   line_( new TLine ),
   latex_( new TLatex ),
   c_( NULL ),
@@ -62,10 +69,18 @@ MyApplication::MyApplication( int argc, char* argv[] ) :
   rT_->kernel( k_ );
   rT_->integrand( rho_ );
   
+  kq_ = new KernelQuadrature( k_, rho_ );
+  kq_->precision( 0.0001 );
+  
+  km_ = new KernelMatrix( k_, rho_ );
+  this->precision( 0.0001 );
+  
   latex_->SetTextFont( 32 );
   latex_->SetTextSize( 0.03 );
   
   if( args.hasOpt( "toffset" ) ) k_->offset( args.get( "toffset", 0.0 ) );
+  if( args.hasOpt( "kquad" ) ) useKq_ = true;
+  if( args.hasOpt( "kmatrix" ) ) this->kernelMatrix( true );
   
   this->update();
   
@@ -83,6 +98,8 @@ MyApplication::~MyApplication(){
   delete k_;
   delete rho_;
   delete rT_;
+  delete kq_;
+  delete km_;
   delete line_;
   delete latex_;
   if( c_ ) delete c_;
@@ -166,16 +183,14 @@ void MyApplication::drawI(){
   double tmin = tRange_[ 0 ] + k_->offset();
   double tmax = tRange_[ 1 ] + k_->offset();
 
-  TGraph *g = new TGraph;
-  
   // calculate value of the transfered function, g(t), at various t
-  double corr = 1.0 / this->evalI( k_->offset() );
-  for( double t = tmin; t < tmax; t += tstep_ ){
-    double v = this->evalI( t );
-    int i = g->GetN();
-    g->Set( i + 1 );
-    g->SetPoint( i, t, v );
-  }
+  vector< double > ts( 1, k_->offset() );
+  for( double t = tmin; t < tmax; t += tstep_ ) ts.push_back( t );
+  vector< double > vs = this->evalI( ts );
+  double corr = 1.0 / vs[ 0 ];
+  
+  TGraph *g = new TGraph( ts.size() - 1 );
+  for( int i = 1; i < ts.size(); i++ ) g->SetPoint( i - 1, ts[ i ], vs[ i ] );
   
   g->SetLineColor( kRed );
   g->SetLineWidth( 2 );
@@ -293,6 +308,11 @@ void MyApplication::toffset( const double& value ) {
   this->update();
 }
 
+void MyApplication::toffset( const std::vector< double >& values ) {
+  k_->offset( values );
+  this->update();
+}
+
 void MyApplication::nLeg( const int& n1, const int& n2 ){
   rT_->nLeg( n1, n2 );
 }
@@ -303,6 +323,19 @@ void MyApplication::nGrid( const int& n ){
 
 void MyApplication::precision( const double& p ){
   rT_->precision( p );
+  kq_->precision( p );
+  // error of KernelMatrix goes as nNode^{-2}: 5E-5 with 1000 nodes
+  if( p > 0.0 ) km_->nNode( int( ceil( 10.0 / sqrt( p ) ) ) );
+}
+
+void MyApplication::kernelQuadrature( const bool& use ){
+  useKq_ = use;
+}
+
+void MyApplication::kernelMatrix( const bool& use ){
+  useKm_ = use;
+  if( useKq_ && useKm_ )
+    cout << "kernelQuadrature() is used rather than kernelMatrix()" << endl;
 }
 
 void MyApplication::amplitude( const double& v ){
@@ -347,6 +380,10 @@ void MyApplication::update(){
   rT_->upper( rho_->upper() );
   rT_->lower( rho_->lower() );
   if( rT_->lower() < tlimit ) rT_->lower( tlimit );
+  kq_->upper( rT_->upper() );
+  kq_->lower( rT_->lower() );
+  km_->upper( rT_->upper() );
+  km_->lower( rT_->lower() );
   
   double trange = 1.5 * fabs( this->hDlower() - k_->offset() );
   if( trange == 0.0 ) {
@@ -382,12 +419,34 @@ void MyApplication::canvas(){
 LineShape* MyApplication::lineShapeObj(){
   LineShape* lS = new LineShape;
   lS->rT_ = rT_;
+  lS->k_ = k_;
+  lS->kq_ = useKq_ ? kq_ : NULL;
+  lS->km_ = useKm_ ? km_ : NULL;
   lS->rho_ = rho_;
   return lS;
 }
 
 double MyApplication::evalI( const double& t ){
-  return (*rT_)( t );
+  if( useKq_ ) return (*kq_)( t );
+  if( useKm_ ) return (*km_)( vector< double >( 1, t ) )[ 0 ];
+  
+  // the kernel is zero beyond rmax( t ): far wings are free
+  double upper = rT_->upper();
+  double rmax  = k_->rmax( t );
+  if( rmax <= rT_->lower() ) return 0.0;
+  if( rmax >= upper ) return (*rT_)( t );
+  
+  rT_->upper( rmax );
+  double v = (*rT_)( t );
+  rT_->upper( upper );
+  return v;
+}
+
+vector< double > MyApplication::evalI( const vector< double >& t ){
+  if( useKm_ && ! useKq_ ) return (*km_)( t );
+  vector< double > v( t.size() );
+  for( int i = 0; i < t.size(); i++ ) v[ i ] = this->evalI( t[ i ] );
+  return v;
 }
 
 ClassImp( MyApplication )
@@ -20,6 +20,8 @@ class TGraph;
 class TCanvas;
 
 class DipoleKernel;
+class KernelQuadrature;
+class KernelMatrix;
 class Density;
 class LineShape;
 
@@ -78,6 +80,7 @@ public:
   
   double toffset();
   void toffset( const double& value );
+  void toffset( const std::vector< double >& values ); // update once for all
 
   void showArguments( TGraph *g );
   
@@ -92,6 +95,19 @@ public:
   void nGrid( const int& n );
   void precision( const double& p );
 
+  // integration split at edges of the kernel (see KernelQuadrature)
+  // instead of the grid integration, for evalI() and LineShape
+  void kernelQuadrature( const bool& use );
+  bool kernelQuadrature() const { return useKq_; }
+  KernelQuadrature* quadrature() { return kq_; }
+  
+  // integration on fixed r nodes for many t at once (see KernelMatrix)
+  // instead of the grid integration, for evalI(), drawI(), Fitter and LineShape.
+  // The number of nodes follows precision().
+  void kernelMatrix( const bool& use );
+  bool kernelMatrix() const { return useKm_; }
+  KernelMatrix* matrix() { return km_; }
+
   Density* density() { return rho_; } 
   //  Density* rho() { return rho_; }       // will be merged to density method
   DipoleKernel* kernel(){ return k_; }
@@ -99,6 +115,10 @@ public:
   LineShape* lineShapeObj();
   
   double evalI( const double& t );
+  
+  // I(t) for all t, same as evalI( t[i] ).
+  // With kernelMatrix(), the density is evaluated once for all t.
+  std::vector< double > evalI( const std::vector< double >& t );
 
   void update();
 private:
@@ -107,6 +127,10 @@ private:
   DipoleKernel* k_;
   Density* rho_;
   Transform::RTransform* rT_;
+  KernelQuadrature* kq_;
+  KernelMatrix* km_;
+  bool useKq_;
+  bool useKm_;
 
   TLine *line_;
   TLatex *latex_;
@@ -16,7 +16,18 @@ NearestNeighbor::~NearestNeighbor(){
 double NearestNeighbor::operator()( const double& x ){
   const double p4 = 4.0 * M_PI;
   double rp4 = rho_ * p4;
-  return a_ * rp4 * pow( x, 2.0 ) * exp( - rp4 * pow( x, 3.0 ) / 3.0 );
+  double x2 = x * x;
+  return a_ * rp4 * x2 * exp( - rp4 * x2 * x / 3.0 );
+}
+
+void NearestNeighbor::eval( const double* x, double* out, const size_t& n ){
+  double rp4 = rho_ * 4.0 * M_PI;
+  double c = a_ * rp4;
+  double e = - rp4 / 3.0;
+  for( size_t i = 0; i < n; i++ ){
+    double x2 = x[ i ] * x[ i ];
+    out[ i ] = c * x2 * exp( e * x2 * x[ i ] );
+  }
 }
 
 double NearestNeighbor::upper() const {
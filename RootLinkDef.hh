@@ -10,6 +10,8 @@
 #pragma link C++ class MyApplication+;
 #pragma link C++ class KernelCore+;
 #pragma link C++ class DipoleKernel+;
+#pragma link C++ class KernelQuadrature+;
+#pragma link C++ class KernelMatrix+;
 #pragma link C++ class Density+;
 #pragma link C++ class AGaus+;
 #pragma link C++ class MixedDensity+;
@@ -0,0 +1,49 @@
+#ifndef Span_hh
+#define Span_hh
+
+#include <cstddef>
+
+/**
+   read-only view of contiguous memory (pointer + size).
+
+   Minimal replacement of std::span (c++20), which is not available with
+   the standard used to compile ROOT dictionaries here.
+   The view does NOT own memory: the owner (vector, mapped file, ...)
+   must outlive it.
+ */
+template <typename T>
+class Span
+{
+  const T* data_;
+  std::size_t size_;
+
+public:
+  Span() : data_(nullptr), size_(0) {}
+  Span(const T* data, std::size_t size) : data_(data), size_(size) {}
+
+  template <typename Container>
+  Span(const Container& c) : data_(c.data()), size_(c.size()) {}
+
+  const T* data() const {return data_;}
+  std::size_t size() const {return size_;}
+  bool empty() const {return size_ == 0;}
+
+  const T* begin() const {return data_;}
+  const T* end() const {return data_ + size_;}
+
+  const T& operator[](std::size_t i) const {return data_[i];}
+  const T& front() const {return data_[0];}
+  const T& back() const {return data_[size_ - 1];}
+
+  /** sub view [offset, offset + count). count is clipped at the end. */
+  Span subspan(std::size_t offset, std::size_t count = static_cast<std::size_t>(-1)) const
+  {
+    if(offset > size_)
+      offset = size_;
+    if(count > size_ - offset)
+      count = size_ - offset;
+    return Span(data_ + offset, count);
+  }
+};
+
+#endif
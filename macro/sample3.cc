@@ -17,9 +17,9 @@ int sample3(){
   ESR esr( "cofeebean-a.txt", 128 );
   
   // Tunning of numerical integration parameteres.
+  // The integral is split at the edges of the kernel: no fine grid is needed.
   app->precision( 0.0001 );
-  app->nGrid( 10 );
-  app->nLeg( 7, 8 );
+  app->kernelQuadrature( true );
   
   app->toffset( 328.87 ); // it will be setted to the maximum in draw method
   app->amplitude( 80.1774 );
@@ -73,9 +73,7 @@ int sample3(){
     g->GetPoint( i, x, y );
     if( ( x > bg[ 0 ][ 0 ] && x < bg[ 0 ][ 1 ] ) ||
 	( x > bg[ 1 ][ 0 ] && x < bg[ 1 ][ 1 ] ) ){
-      int iNew = gBG->GetN();
-      gBG->Set( iNew + 1 );
-      gBG->SetPoint( iNew, x, y );
+      gBG->SetPoint( gBG->GetN(), x, y );
     }
   }
 
@@ -88,21 +86,13 @@ int sample3(){
   gPad->Update();
 
   // Parametize background shape with 2nd polynominal.
-  // Parameters will be determine by fitting tails of the ESR spectrum
-  TF1 *fBG = new TF1( "fBG", "pol2", sig[ 0 ], sig[ 1 ] );
-  gBG->Fit( fBG, "N"  );
+  // Parameters will be determine by fitting tails of the ESR spectrum,
+  // and the background is subtracted from all points at once.
+  esr.SubtractPolynomialBaseline( { { bg[ 0 ][ 0 ], bg[ 0 ][ 1 ] },
+				    { bg[ 1 ][ 0 ], bg[ 1 ][ 1 ] } }, 2 );
   
   // signal data preparation
-  // backgound contribution will be subtracted using the fitted bachground shape
-  TGraph *gSig = new TGraph;
-  for( int i = 0; i < g->GetN(); i++ ){
-    double x, y;
-    g->GetPoint( i, x, y );
-    if(  x < sig[ 0 ] || x > sig[ 1 ] ) continue;
-    int iNew = gSig->GetN();
-    gSig->Set( iNew + 1 );
-    gSig->SetPoint( iNew, x, y - fBG->Eval( x ) );
-  }
+  TGraph *gSig = (TGraph*) esr.GetGraphBaselineCorrected( sig[ 0 ], sig[ 1 ] )->Clone();
   
   gSig->SetMarkerStyle( 20 );
   gSig->SetMarkerColor( kCyan );
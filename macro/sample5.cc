@@ -12,16 +12,15 @@ int sample5(){
   ESR esr( "cal2_1.txt", 128 ); // prepare ESR data from the given file
 
   // Tunning of numerical integration parameteres.
+  // The integral is split at the edges of the kernel: no fine grid is needed.
   app->precision( 0.0001 );
-  app->nGrid( 10 );
-  app->nLeg( 7, 8 );
+  app->kernelQuadrature( true );
   
   // ESR lines are at 319.8, 321.3 and 322.8
-  // by repeating toffset methods, the new esr line positions are added.
+  // they are found as zero crossings of the spectrum, and all of them
+  // are added to the esr line positions at once.
   // (not replacing the stored value)
-  app->toffset( 319.75 );
-  app->toffset( 321.3 );
-  app->toffset( 322.84 );
+  app->toffset( esr.DetectFeatures().GetCenters() );
 
   // configure density distribution
   app->amplitude( 47.1337 );
@@ -4,9 +4,8 @@ int sample9(){
 
   ESRLine esr( "cal2_1.txt" );
 
-  double l1 = esr.find( 319.7, 319.85 );
-  double l2 = esr.find( 321.2, 321.4 );
-  double l3 = esr.find( 322.75, 322.95 );
+  // all lines are found without windows given by hand
+  std::vector< double > lines = esr.find();
 
   TGraph *g = (TGraph*) esr.GetGraph()->Clone();
   
@@ -30,23 +29,17 @@ int sample9(){
   line->SetLineWidth( 1 );
   line->SetLineStyle( 1 );
   line->SetLineColor( kGreen + 3 );
-  line->DrawLine( l1, ymin, l1, ymax );
-  line->DrawLine( l2, ymin, l2, ymax );
-  line->DrawLine( l3, ymin, l3, ymax );
+  for( int i = 0; i < lines.size(); i++ )
+    line->DrawLine( lines[ i ], ymin, lines[ i ], ymax );
 
   TLatex *latex = new TLatex;
   
   ostringstream  ostr;
-  ostr << "1: " << l1 << " mT";
-  latex->DrawLatex( xmin + 7.0 * dx, ymin + 8.5 * dy, ostr.str().c_str() );
-
-  ostr.str( "" );
-  ostr << "1: " << l2 << " mT";
-  latex->DrawLatex( xmin + 7.0 * dx, ymin + 7.5 * dy, ostr.str().c_str() );
-
-  ostr.str( "" );
-  ostr << "1: " << l3 << " mT";
-  latex->DrawLatex( xmin + 7.0 * dx, ymin + 6.5 * dy, ostr.str().c_str() );
+  for( int i = 0; i < lines.size(); i++ ){
+    ostr.str( "" );
+    ostr << i + 1 << ": " << lines[ i ] << " mT";
+    latex->DrawLatex( xmin + 7.0 * dx, ymin + ( 8.5 - i ) * dy, ostr.str().c_str() );
+  }
 
   
   return 0;
@@ -51,6 +51,8 @@ void usage(){
   args.usage( "nleg", "4,6", "lower and upper limit of LegQuadrature" );
   args.usage( "nGrid", 4, "number of segment for grid integration" );
   args.usage( "precision", 0.01, "required precision for the grid integration" );
+  args.usage( "kquad", "", "integration split at edges of the kernel instead of the grid integration" );
+  args.usage( "kmatrix", "", "integration on fixed r nodes for all t at once instead of the grid integration" );
   args.log() << "-------------------------------------------------" << endl; 
   
   exit( 0 );